@@ -1,22 +1,55 @@
 
 #include "BitcoinExchange.hpp"
 
+#include <algorithm>
+#include <limits>
+
+const std::size_t BitcoinExchange::npos = static_cast<std::size_t>(-1);
+
+Query::Query() : portfolio(false), total(0.0) {}
 
 BitcoinExchange::BitcoinExchange() {}
 
 BitcoinExchange::BitcoinExchange(const BitcoinExchange& other) {
-  this->_rateMap = other._rateMap;
+  *this = other;
 }
 
 BitcoinExchange& BitcoinExchange::operator=(const BitcoinExchange& other) {
-  if (this != &other) 
-    this->_rateMap = other._rateMap;
+  if (this != &other) {
+    this->_dates = other._dates;
+    this->_assets = other._assets;
+    this->_assetIndex = other._assetIndex;
+    this->_rates = other._rates;
+  }
   return *this;
 }
 
 BitcoinExchange::~BitcoinExchange() {}
 
 
+static void trim(std::string& str) {
+  str.erase(0, str.find_first_not_of(" \t\r"));
+  str.erase(str.find_last_not_of(" \t\r") + 1);
+}
+
+static void splitFields(const std::string& line, std::vector<std::string>& fields) {
+  fields.clear();
+  std::stringstream ss(line);
+  std::string field;
+  while (std::getline(ss, field, ',')) {
+    trim(field);
+    fields.push_back(field);
+  }
+}
+
+std::size_t BitcoinExchange::addAsset(const std::string& name) {
+  std::map<std::string, std::size_t>::iterator it = _assetIndex.find(name);
+  if (it != _assetIndex.end())
+    return it->second;
+  _assets.push_back(name);
+  return _assetIndex[name] = _assets.size() - 1;
+}
+
 void BitcoinExchange::loadRateDatabase(const std::string& filename) {
   std::ifstream file(filename.c_str());
   if (!file.is_open()) {
@@ -25,29 +58,77 @@ void BitcoinExchange::loadRateDatabase(const std::string& filename) {
   }
 
   std::string line;
+  std::vector<std::string> fields;
   std::getline(file, line);
+  splitFields(line, fields);
+  bool isLong = fields.size() == 3 && fields[1] == "asset";
+  std::vector<std::size_t> columns;
+  if (!isLong)
+    for (std::size_t i = 1; i < fields.size(); ++i)
+      columns.push_back(addAsset(fields[i]));
 
+  // Rows are gathered by date first; later lines override earlier ones
+  const double missing = std::numeric_limits<double>::quiet_NaN();
+  std::map<std::string, std::vector<double> > rows;
   while (std::getline(file, line)) {
-    std::stringstream ss(line);
-    std::string date, rateStr;
-    if (!std::getline(ss, date, ',') || !std::getline(ss, rateStr)) {
+    splitFields(line, fields);
+    if (fields.empty() || fields[0].empty())
       continue;
+    if (isLong) {
+      if (fields.size() < 3 || fields[1].empty() || fields[2].empty())
+        continue;
+      std::vector<double>& row = rows[fields[0]];
+      std::size_t asset = addAsset(fields[1]);
+      if (row.size() <= asset)
+        row.resize(asset + 1, missing);
+      row[asset] = std::atof(fields[2].c_str());
+    } else {
+      std::vector<double>& row = rows[fields[0]];
+      if (row.size() < _assets.size())
+        row.resize(_assets.size(), missing);
+      // Blank cells are left to the forward fill, whichever column they are in
+      for (std::size_t i = 0; i < columns.size() && i + 1 < fields.size(); ++i)
+        if (!fields[i + 1].empty())
+          row[columns[i]] = std::atof(fields[i + 1].c_str());
     }
-    double rate = std::atof(rateStr.c_str());
-    // double rate = std::stod(rateStr);
-    _rateMap[date] = rate;
+  }
+
+  // Merge with what is already loaded, then lay the columns out
+  std::size_t height = _dates.size();
+  for (std::size_t r = 0; r < height; ++r) {
+    std::vector<double>& row = rows[_dates[r]];
+    row.resize(_assets.size(), missing);
+    for (std::size_t a = 0; a < _assets.size(); ++a)
+      if (row[a] != row[a] && a * height + r < _rates.size())
+        row[a] = _rates[a * height + r];
+  }
+  _dates.clear();
+  _dates.reserve(rows.size());
+  _rates.assign(_assets.size() * rows.size(), missing);
+  height = rows.size();
+  for (std::map<std::string, std::vector<double> >::const_iterator it = rows.begin();
+       it != rows.end(); ++it) {
+    std::size_t r = _dates.size();
+    _dates.push_back(it->first);
+    for (std::size_t a = 0; a < it->second.size(); ++a)
+      _rates[a * height + r] = it->second[a];
+  }
+  for (std::size_t a = 0; a < _assets.size(); ++a) {
+    double* column = &_rates[a * height];
+    for (std::size_t r = 1; r < height; ++r)
+      if (column[r] != column[r])
+        column[r] = column[r - 1];
   }
 }
 
 double BitcoinExchange::getRateBydata(const std::string& date) const {
-  std::map<std::string, double>::const_iterator it = _rateMap.lower_bound(date);
-  if (it != _rateMap.begin() && (it == _rateMap.end() || it->first != date))
-    --it;
-  if (it == _rateMap.end()) {
+  std::size_t row = findDate(date);
+  double rate = row == npos || _assets.empty() ? 0.0 : getRate(row, 0);
+  if (row == npos || _assets.empty() || rate != rate) {
     std::cerr << "Error: date not found in DB." << std::endl;
     return 0.0;
   }
-  return it->second;
+  return rate;
 }
 
 bool BitcoinExchange::isValidDate(const std::string& date) const {
@@ -65,8 +146,157 @@ bool BitcoinExchange::isValidDate(const std::string& date) const {
 
 bool BitcoinExchange::isValidValue(const std::string& valueStr, double& value) const {
   std::stringstream ss(valueStr);
-  ss >> value;
-  if (!(ss >> value)|| !ss.eof() || value < 0 || value > 1000)
+  if (!(ss >> value) || !ss.eof() || value < 0 || value > 1000)
+    return false;
+  return true;
+}
+
+std::size_t BitcoinExchange::assetCount() const {
+  return _assets.size();
+}
+
+const std::string& BitcoinExchange::getAssetName(std::size_t asset) const {
+  return _assets.at(asset);
+}
+
+std::size_t BitcoinExchange::findAsset(const std::string& name) const {
+  std::map<std::string, std::size_t>::const_iterator it = _assetIndex.find(name);
+  return it == _assetIndex.end() ? npos : it->second;
+}
+
+std::size_t BitcoinExchange::findDate(const std::string& date) const {
+  if (_dates.empty())
+    return npos;
+  std::vector<std::string>::const_iterator it =
+      std::upper_bound(_dates.begin(), _dates.end(), date);
+  if (it != _dates.begin())
+    --it;
+  return it - _dates.begin();
+}
+
+std::size_t BitcoinExchange::findDate(const std::string& date, std::size_t from) const {
+  if (from >= _dates.size())
+    return findDate(date);
+  std::vector<std::string>::const_iterator it =
+      std::upper_bound(_dates.begin() + from, _dates.end(), date);
+  if (it != _dates.begin())
+    --it;
+  return it - _dates.begin();
+}
+
+double BitcoinExchange::getRate(std::size_t row, std::size_t asset) const {
+  return _rates[asset * _dates.size() + row];
+}
+
+double BitcoinExchange::getValue(std::size_t row, const std::vector<std::size_t>& assets,
+                                 const std::vector<double>& amounts,
+                                 std::size_t quote) const {
+  const double* base = &_rates[row];
+  std::size_t height = _dates.size();
+  double total = 0.0;
+  for (std::size_t i = 0; i < assets.size(); ++i)
+    total += amounts[i] * base[assets[i] * height];
+  if (quote != npos) {
+    double rate = base[quote * height];
+    if (rate != rate || rate == 0.0)
+      return std::numeric_limits<double>::quiet_NaN();
+    total /= rate;
+  }
+  return total;
+}
+
+bool BitcoinExchange::parseQuery(const std::string& line, Query& query) const {
+  query.date.clear();
+  query.assets.clear();
+  query.amounts.clear();
+  query.portfolio = false;
+  query.total = 0.0;
+  query.error.clear();
+
+  std::stringstream ss(line);
+  std::string valueStr;
+  if (!std::getline(ss, query.date, ',') || !std::getline(ss, valueStr)) {
+    query.error = "Error: bad input => " + line;
     return false;
+  }
+  trim(query.date);
+  if (!isValidDate(query.date)) {
+    query.error = "Error: bad input => " + query.date;
+    return false;
+  }
+
+  // A portfolio names the asset of every item: "1,5" is a bad value, not two
+  std::vector<std::string> items;
+  splitFields(valueStr, items);
+  std::size_t unnamed = 0;
+  for (std::size_t i = 0; i < items.size(); ++i)
+    if (items[i].find_last_of(" \t") == std::string::npos)
+      ++unnamed;
+  if (items.empty() || (items.size() > 1 && unnamed > 0)) {
+    query.error = "Error: bad input => " + line;
+    return false;
+  }
+  query.portfolio = unnamed == 0;
+
+  for (std::size_t i = 0; i < items.size(); ++i) {
+    std::string& item = items[i];
+    std::size_t asset = 0;
+    std::size_t space = item.find_last_of(" \t");
+    if (space != std::string::npos) {
+      asset = findAsset(item.substr(space + 1));
+      if (asset == npos) {
+        query.error = "Error: unknown asset => " + item.substr(space + 1);
+        return false;
+      }
+      item.erase(space);
+      trim(item);
+    }
+    double value = 0;
+    if (!isValidValue(item, value)) {
+      if (item.empty())
+        query.error = "Error: bad input => " + line;
+      else if (value < 0)
+        query.error = "Error: not a positive number.";
+      else
+        query.error = "Error: too large a number.";
+      return false;
+    }
+    query.assets.push_back(asset);
+    query.amounts.push_back(value);
+  }
   return true;
 }
+
+void BitcoinExchange::valueQuery(Query& query, std::size_t row, std::size_t quote) const {
+  if (!query.error.empty())
+    return;
+  if (row != npos && quote != npos) {
+    double rate = getRate(row, quote);
+    if (rate != rate || rate == 0.0) {
+      query.error = "Error: no rate for " + getAssetName(quote) + " at this date.";
+      return;
+    }
+  }
+  query.total = row == npos || _assets.empty()
+                    ? std::numeric_limits<double>::quiet_NaN()
+                    : getValue(row, query.assets, query.amounts, quote);
+  if (query.total != query.total)
+    query.error = "Error: date not found in DB.";
+}
+
+void BitcoinExchange::writeQuery(std::ostream& os, const Query& query, std::size_t quote) const {
+  if (!query.error.empty()) {
+    os << query.error;
+    return;
+  }
+  os << query.date << "=>";
+  if (!query.portfolio && quote == npos) {
+    os << query.amounts[0] << " = " << query.total;
+    return;
+  }
+  for (std::size_t i = 0; i < query.amounts.size(); ++i)
+    os << (i ? " + " : "") << query.amounts[i] << " " << getAssetName(query.assets[i]);
+  os << " = " << query.total;
+  if (quote != npos)
+    os << " " << getAssetName(quote);
+}
@@ -5,14 +5,46 @@
 #include <iostream>
 #include <string>
 #include <map>
+#include <vector>
 #include <fstream>
 #include <sstream>
 #include <cstdlib>
 
+// One input line, as btc reads it: "date,value" in the first asset, or a
+// portfolio "date,amount ASSET, amount ASSET, ..." where every item names
+// its asset. 'error' holds the message once the line is rejected.
+struct Query {
+  std::string date;
+  std::vector<std::size_t> assets;
+  std::vector<double> amounts;
+  bool portfolio;
+  double total;
+  std::string error;
+
+  Query();
+};
+
+// Rates are stored by column: one sorted date column shared by every asset
+// and one contiguous rate column per asset. A lookup finds the date row once
+// and reads as many assets as needed from that row.
+//
+// The database is either wide ("date,BTC,ETH,...", one column per asset;
+// the original "date,exchange_rate" is the one-asset case) or long
+// ("date,asset,rate", one line per asset and date). A date an asset has no
+// rate for takes the asset's previous rate, so every row answers "the rate
+// at or before this date"; before an asset's first rate it is NaN.
 class BitcoinExchange {
   private:
-    std::map<std::string, double> _rateMap;
+    std::vector<std::string> _dates;
+    std::vector<std::string> _assets;
+    std::map<std::string, std::size_t> _assetIndex;
+    // Column-major: asset a's column is [a * _dates.size(), (a + 1) * ...)
+    std::vector<double> _rates;
+
+    std::size_t addAsset(const std::string& name);
   public:
+    static const std::size_t npos;
+
     BitcoinExchange();
     BitcoinExchange(const BitcoinExchange& other);
     BitcoinExchange& operator=(const BitcoinExchange& other);
@@ -22,6 +54,31 @@ class BitcoinExchange {
     double getRateBydata(const std::string& date) const;
     bool isValidDate(const std::string& date) const;
     bool isValidValue(const std::string& valueStr, double& value) const;
+
+    std::size_t assetCount() const;
+    const std::string& getAssetName(std::size_t asset) const;
+    std::size_t findAsset(const std::string& name) const;
+    // Row of the last date not after 'date' (the first row if 'date' is
+    // earlier than every date), npos if the database is empty
+    std::size_t findDate(const std::string& date) const;
+    // Same, searching only from row 'from' on: for dates known to be at or
+    // after _dates[from], such as a batch of queries in date order
+    std::size_t findDate(const std::string& date, std::size_t from) const;
+    double getRate(std::size_t row, std::size_t asset) const;
+    // Sum of amounts[i] * rate of assets[i], all read from the one row, in
+    // the database's unit or, given a quote asset, converted into it; NaN
+    // if the quote asset's rate there is missing or zero
+    double getValue(std::size_t row, const std::vector<std::size_t>& assets,
+                    const std::vector<double>& amounts,
+                    std::size_t quote = npos) const;
+
+    // The three steps btc takes for each input line. parseQuery validates
+    // the line and returns false, with the error set, if it is rejected;
+    // valueQuery prices it at 'row', as found by findDate; writeQuery prints
+    // the answer or the error, without the end of line.
+    bool parseQuery(const std::string& line, Query& query) const;
+    void valueQuery(Query& query, std::size_t row, std::size_t quote = npos) const;
+    void writeQuery(std::ostream& os, const Query& query, std::size_t quote = npos) const;
 };
 
 
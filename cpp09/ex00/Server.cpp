@@ -0,0 +1,283 @@
+
+#include "Server.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// A client's unanswered input may not grow past a line this long, and it is
+// not read from while this much output is waiting for it
+#define MAX_LINE 4096
+#define MAX_PENDING (1 << 20)
+#define MAX_EVENTS 64
+// Per wakeup: bytes read from a client, lines taken from a client, and
+// lines in the whole batch
+#define READ_SIZE 65536
+#define MAX_TAKE 256
+#define MAX_BATCH 4096
+
+Server::Client::Client() : eof(false), events(0) {}
+
+Server::Server(const BitcoinExchange& btc, const std::string& path)
+    : _btc(btc), _path(path), _listen(-1), _epoll(-1), _acceptPaused(false) {
+  sockaddr_un addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (path.empty() || path.size() >= sizeof(addr.sun_path))
+    throw std::runtime_error("invalid socket path => " + path);
+  std::memcpy(addr.sun_path, path.c_str(), path.size());
+
+  struct stat st;
+  if (::stat(path.c_str(), &st) == 0) {
+    if (!S_ISSOCK(st.st_mode))
+      throw std::runtime_error("not a socket => " + path);
+    ::unlink(path.c_str());
+  }
+
+  _listen = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (_listen < 0)
+    fail("socket");
+  if (::bind(_listen, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+    fail("bind");
+  if (::listen(_listen, SOMAXCONN) < 0)
+    fail("listen");
+  _epoll = ::epoll_create1(EPOLL_CLOEXEC);
+  if (_epoll < 0)
+    fail("epoll_create1");
+  watch(_listen, EPOLL_CTL_ADD, EPOLLIN);
+}
+
+Server::~Server() {
+  for (std::map<int, Client>::iterator it = _clients.begin(); it != _clients.end(); ++it)
+    ::close(it->first);
+  if (_epoll >= 0)
+    ::close(_epoll);
+  if (_listen >= 0) {
+    ::close(_listen);
+    ::unlink(_path.c_str());
+  }
+}
+
+// Constructor failures: the destructor will not run, so clean up here
+void Server::fail(const std::string& what) {
+  std::string message = what + ": " + std::strerror(errno);
+  if (_epoll >= 0)
+    ::close(_epoll);
+  if (_listen >= 0)
+    ::close(_listen);
+  _epoll = _listen = -1;
+  throw std::runtime_error(message);
+}
+
+void Server::watch(int fd, int op, unsigned events) {
+  epoll_event event;
+  std::memset(&event, 0, sizeof(event));
+  event.events = events;
+  event.data.fd = fd;
+  if (::epoll_ctl(_epoll, op, fd, &event) < 0 && op != EPOLL_CTL_DEL)
+    throw std::runtime_error(std::string("epoll_ctl: ") + std::strerror(errno));
+}
+
+void Server::run(volatile std::sig_atomic_t& stop) {
+  epoll_event events[MAX_EVENTS];
+  std::vector<Request> batch;
+  std::vector<int> ready;
+  while (!stop) {
+    // Lines left over from the last wakeup: poll, do not wait
+    int n = ::epoll_wait(_epoll, events, MAX_EVENTS, _pending.empty() ? -1 : 0);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      throw std::runtime_error(std::string("epoll_wait: ") + std::strerror(errno));
+    }
+
+    ready.clear();
+    for (int i = 0; i < n; ++i) {
+      int fd = events[i].data.fd;
+      if (fd == _listen) {
+        acceptClients();
+        continue;
+      }
+      if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+        receive(fd);
+      ready.push_back(fd);
+    }
+    ready.insert(ready.end(), _pending.begin(), _pending.end());
+    std::sort(ready.begin(), ready.end());
+    ready.erase(std::unique(ready.begin(), ready.end()), ready.end());
+
+    // Gather the lines of this wakeup, from every client, into one batch
+    batch.clear();
+    for (std::size_t i = 0; i < ready.size(); ++i)
+      take(ready[i], batch);
+
+    resolve(batch);
+    std::ostringstream os;
+    for (std::size_t i = 0; i < batch.size(); ++i) {
+      os.str("");
+      _btc.writeQuery(os, batch[i].query);
+      os << '\n';
+      _clients[batch[i].fd].out += os.str();
+    }
+    for (std::size_t i = 0; i < ready.size(); ++i)
+      flush(ready[i]);
+  }
+}
+
+void Server::acceptClients() {
+  for (;;) {
+    int fd = ::accept4(_listen, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+        // The connection stays queued and the socket readable: stop
+        // watching it until a client is dropped and frees a descriptor
+        std::cerr << "Error: accept: " << std::strerror(errno) << std::endl;
+        _acceptPaused = true;
+        watch(_listen, EPOLL_CTL_MOD, 0);
+      } else if (errno != EAGAIN && errno != EWOULDBLOCK)
+        std::cerr << "Error: accept: " << std::strerror(errno) << std::endl;
+      return;
+    }
+    Client& client = _clients[fd];
+    client.events = EPOLLIN;
+    watch(fd, EPOLL_CTL_ADD, client.events);
+  }
+}
+
+// One read at most; level-triggered epoll reports the rest next time
+void Server::receive(int fd) {
+  Client& client = _clients[fd];
+  if (client.eof || client.out.size() >= MAX_PENDING || client.in.size() >= READ_SIZE)
+    return;
+  char buffer[READ_SIZE];
+  ssize_t n;
+  do
+    n = ::recv(fd, buffer, sizeof(buffer), 0);
+  while (n < 0 && errno == EINTR);
+  if (n > 0)
+    client.in.append(buffer, n);
+  else if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+    client.eof = true;
+}
+
+// Moves up to MAX_TAKE complete lines into the batch; a client left with
+// more is kept pending, unless its answers are piling up
+void Server::take(int fd, std::vector<Request>& batch) {
+  Client& client = _clients[fd];
+  _pending.erase(fd);
+  if (client.out.size() >= MAX_PENDING)
+    return;
+
+  std::size_t start = 0, taken = 0;
+  std::size_t end = client.in.find('\n');
+  for (; end != std::string::npos && taken < MAX_TAKE && batch.size() < MAX_BATCH;
+       end = client.in.find('\n', start), ++taken) {
+    parse(fd, client.in.substr(start, end - start), batch);
+    start = end + 1;
+  }
+  client.in.erase(0, start);
+  if (end != std::string::npos) {
+    _pending.insert(fd);
+    return;
+  }
+
+  if (client.in.size() > MAX_LINE) {
+    client.in.clear();
+    client.eof = true;
+  }
+  // Like getline, take a last line that has no end of line
+  if (client.eof && !client.in.empty() && batch.size() < MAX_BATCH) {
+    parse(fd, client.in, batch);
+    client.in.clear();
+  } else if (client.eof && !client.in.empty())
+    _pending.insert(fd);
+}
+
+// Valid lines are left for resolve() to price
+void Server::parse(int fd, const std::string& line, std::vector<Request>& batch) const {
+  batch.push_back(Request());
+  batch.back().fd = fd;
+  _btc.parseQuery(line, batch.back().query);
+}
+
+bool Server::RequestDateLess::operator()(std::size_t a, std::size_t b) const {
+  return (*batch)[a].query.date < (*batch)[b].query.date;
+}
+
+// Prices the valid queries in date order, each search starting from the row
+// the previous date was found at
+void Server::resolve(std::vector<Request>& batch) const {
+  std::vector<std::size_t> order;
+  for (std::size_t i = 0; i < batch.size(); ++i)
+    if (batch[i].query.error.empty())
+      order.push_back(i);
+  RequestDateLess less;
+  less.batch = &batch;
+  std::sort(order.begin(), order.end(), less);
+
+  std::size_t row = BitcoinExchange::npos;
+  for (std::size_t i = 0; i < order.size(); ++i) {
+    Query& query = batch[order[i]].query;
+    if (i == 0)
+      row = _btc.findDate(query.date);
+    else if (query.date != batch[order[i - 1]].query.date)
+      row = _btc.findDate(query.date, row);
+    _btc.valueQuery(query, row);
+  }
+}
+
+// Writes what the socket takes, then watches for whatever is still needed
+void Server::flush(int fd) {
+  Client& client = _clients[fd];
+  std::size_t sent = 0;
+  while (sent < client.out.size()) {
+    ssize_t n = ::send(fd, client.out.data() + sent, client.out.size() - sent,
+                       MSG_NOSIGNAL);
+    if (n >= 0)
+      sent += n;
+    else if (errno == EINTR)
+      continue;
+    else if (errno == EAGAIN || errno == EWOULDBLOCK)
+      break;
+    else {
+      sent = client.out.size();
+      client.eof = true;
+    }
+  }
+  client.out.erase(0, sent);
+
+  unsigned events = 0;
+  if (!client.eof && client.out.size() < MAX_PENDING)
+    events |= EPOLLIN;
+  if (!client.out.empty())
+    events |= EPOLLOUT;
+  // Answers drained below the limit: lines held back can be taken again
+  if (client.out.size() < MAX_PENDING &&
+      (client.in.find('\n') != std::string::npos || (client.eof && !client.in.empty())))
+    _pending.insert(fd);
+  if (events == 0 && !_pending.count(fd))
+    drop(fd);
+  else if (events != client.events) {
+    client.events = events;
+    watch(fd, EPOLL_CTL_MOD, events);
+  }
+}
+
+void Server::drop(int fd) {
+  watch(fd, EPOLL_CTL_DEL, 0);
+  ::close(fd);
+  _clients.erase(fd);
+  _pending.erase(fd);
+  if (_acceptPaused) {
+    _acceptPaused = false;
+    watch(_listen, EPOLL_CTL_MOD, EPOLLIN);
+  }
+}
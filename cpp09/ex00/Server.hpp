@@ -0,0 +1,74 @@
+
+#ifndef SERVER_HPP
+#define SERVER_HPP
+
+#include "BitcoinExchange.hpp"
+
+#include <csignal>
+#include <set>
+
+// Resident query server: keeps one BitcoinExchange loaded and answers the
+// lines btc reads, sent over a Unix domain socket, one answer line per query
+// line, through the same parseQuery, valueQuery and writeQuery as btc.
+// Clients may pipeline: any number of lines can be in flight on a
+// connection, answers come back in order.
+//
+// A single epoll loop serves every client. The lines taken in one wakeup,
+// from all clients together, are looked up as one batch in date order, so
+// queries on the same date share a search and the others each search only
+// the rows after the previous one. Each wakeup reads at most one buffer and
+// takes a bounded number of lines per client, so no client holds the loop;
+// a client whose answers are piling up is not read from until they drain.
+class Server {
+  private:
+    struct Client {
+      std::string in;
+      std::string out;
+      bool eof;
+      unsigned events;
+
+      Client();
+    };
+
+    struct Request {
+      int fd;
+      Query query;
+    };
+
+    struct RequestDateLess {
+      const std::vector<Request>* batch;
+
+      bool operator()(std::size_t a, std::size_t b) const;
+    };
+
+    const BitcoinExchange& _btc;
+    std::string _path;
+    int _listen;
+    int _epoll;
+    std::map<int, Client> _clients;
+    // Clients with complete lines still waiting to be taken
+    std::set<int> _pending;
+    bool _acceptPaused;
+
+    Server(const Server& other);
+    Server& operator=(const Server& other);
+
+    void fail(const std::string& what);
+    void watch(int fd, int op, unsigned events);
+    void acceptClients();
+    void receive(int fd);
+    void take(int fd, std::vector<Request>& batch);
+    void parse(int fd, const std::string& line, std::vector<Request>& batch) const;
+    void resolve(std::vector<Request>& batch) const;
+    void flush(int fd);
+    void drop(int fd);
+  public:
+    // Binds 'path', replacing a stale socket left there; throws on failure
+    Server(const BitcoinExchange& btc, const std::string& path);
+    ~Server();
+
+    // Serves clients until 'stop' is set, typically by a signal handler
+    void run(volatile std::sig_atomic_t& stop);
+};
+
+#endif
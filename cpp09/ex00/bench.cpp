@@ -0,0 +1,301 @@
+
+#include "BitcoinExchange.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Throughput benchmark of the btc pipeline on generated data. Each run
+// writes a rate database and an input file, then times the stages of btc
+// one by one:
+//   load    BitcoinExchange::loadRateDatabase on the database
+//   parse   reading the input and BitcoinExchange::parseQuery on each line
+//   lookup  findDate and valueQuery for every valid line
+//   output  writeQuery for every line, answers and errors alike
+// These are the calls btc's main loop and btcd make, so the figures follow
+// the real pipeline.
+// Options, all "--name=value":
+//   rows     database rows, one per day from 2009-01-02 (default 5000)
+//   lines    input lines (default 100000)
+//   dates    sorted, random or clustered input dates (default random)
+//   invalid  share of invalid input lines, 0 to 1 (default 0.05)
+//   seed     random seed (default 42)
+//   dir      keep the generated data.csv and input.txt in this directory,
+//            which must already exist
+//   out      also write the results to this file, only once all runs passed
+// Without options other than 'out' a sweep over sizes and date
+// distributions is run.
+// Output: one tab separated line per run and stage; 'lines' and 'bytes' are
+// what the stage consumed (produced, for output; the dates searched, for
+// lookup).
+
+struct Config {
+  unsigned long rows;
+  unsigned long lines;
+  std::string dates;
+  double invalid;
+  unsigned seed;
+  std::string dir;
+  std::string out;
+
+  Config() : rows(5000), lines(100000), dates("random"), invalid(0.05), seed(42) {}
+};
+
+static unsigned long getTime() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000UL + ts.tv_nsec / 1000;
+}
+
+// Day 0 is 2009-01-01, day 14245 after 1970-01-01; proleptic Gregorian
+static std::string dateString(unsigned long day) {
+  long z = static_cast<long>(day) + 14245 + 719468;
+  long era = z / 146097;
+  long doe = z - era * 146097;
+  long yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  long doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  long mp = (5 * doy + 2) / 153;
+  long d = doy - (153 * mp + 2) / 5 + 1;
+  long m = mp < 10 ? mp + 3 : mp - 9;
+  long y = yoe + era * 400 + (m <= 2);
+  char buffer[64];
+  std::sprintf(buffer, "%04ld-%02ld-%02ld", y, m, d);
+  return buffer;
+}
+
+static double random01() {
+  return std::rand() / (RAND_MAX + 1.0);
+}
+
+static unsigned long writeFile(const std::string& path, const std::string& data) {
+  std::ofstream file(path.c_str());
+  if (!(file << data) || !file.flush())
+    throw std::runtime_error("could not write " + path);
+  return data.size();
+}
+
+// One rate per day, as a random walk
+static std::string generateDatabase(const Config& config) {
+  std::ostringstream os;
+  os << "date,exchange_rate\n";
+  double rate = 0.1;
+  for (unsigned long r = 0; r < config.rows; ++r) {
+    rate *= 0.95 + 0.1 * random01();
+    os << dateString(r + 1) << ',' << rate << '\n';
+  }
+  return os.str();
+}
+
+// Query dates fall within the database's days, so valid lines all resolve
+static std::string generateInput(const Config& config) {
+  std::vector<unsigned long> centers;
+  for (int i = 0; i < 16; ++i)
+    centers.push_back(std::rand() % config.rows);
+
+  std::ostringstream os;
+  os << "date,value\n";
+  for (unsigned long i = 0; i < config.lines; ++i) {
+    unsigned long day;
+    if (config.dates == "sorted")
+      day = i * config.rows / config.lines;
+    else if (config.dates == "clustered") {
+      long offset = static_cast<long>(centers[std::rand() % centers.size()]) +
+                    std::rand() % 31 - 15;
+      day = offset < 0 ? 0 : std::min<unsigned long>(offset, config.rows - 1);
+    } else
+      day = std::rand() % config.rows;
+    std::string date = dateString(day + 1);
+
+    if (random01() >= config.invalid) {
+      os << date << ',' << (std::rand() % 100000) / 100.0 << '\n';
+      continue;
+    }
+    switch (std::rand() % 5) {
+    case 0: os << date.substr(0, 5) << "13-40,1\n"; break;
+    case 1: os << date << ",-" << std::rand() % 1000 << '\n'; break;
+    case 2: os << date << ',' << 1001 + std::rand() % 100000 << '\n'; break;
+    case 3: os << date << ',' << std::rand() % 10 << ',' << std::rand() % 10 << '\n'; break;
+    default: os << date << '\n'; break;
+    }
+  }
+  return os.str();
+}
+
+static void report(std::ostream& results, const Config& config, const char* stage,
+                   unsigned long lines, unsigned long bytes, unsigned long us) {
+  double seconds = (us ? us : 1) / 1e6;
+  std::ostringstream os;
+  os << stage << '\t' << config.dates << '\t' << config.rows << '\t'
+            << config.lines << '\t' << config.invalid << '\t' << lines << '\t'
+            << bytes << '\t' << us << '\t'
+            << static_cast<unsigned long>(lines / seconds) << '\t'
+            << static_cast<unsigned long>(bytes / seconds) << '\n';
+  std::cout << os.str() << std::flush;
+  results << os.str();
+}
+
+// Removes a run's temporary directory and the files generated in it however
+// bench() returns, so a failed run leaves nothing behind in /tmp
+struct TempDir {
+  std::string path;
+  std::vector<std::string> files;
+
+  ~TempDir() {
+    for (std::size_t i = 0; i < files.size(); ++i)
+      std::remove(files[i].c_str());
+    if (!path.empty())
+      ::rmdir(path.c_str());
+  }
+};
+
+static void bench(const Config& config, std::ostream& results) {
+  std::srand(config.seed);
+  std::string dir = config.dir;
+  TempDir temp;
+  struct stat st;
+  if (!dir.empty() && (::stat(dir.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)))
+    throw std::runtime_error("directory does not exist => " + dir);
+  if (dir.empty()) {
+    char tmpl[] = "/tmp/btc_bench.XXXXXX";
+    if (!mkdtemp(tmpl))
+      throw std::runtime_error(std::string("mkdtemp: ") + std::strerror(errno));
+    dir = temp.path = tmpl;
+  }
+  std::string dbPath = dir + "/data.csv";
+  std::string inputPath = dir + "/input.txt";
+  if (!temp.path.empty()) {
+    temp.files.push_back(dbPath);
+    temp.files.push_back(inputPath);
+  }
+  unsigned long dbBytes = writeFile(dbPath, generateDatabase(config));
+  unsigned long inputBytes = writeFile(inputPath, generateInput(config));
+
+  // Load
+  BitcoinExchange btc;
+  unsigned long start = getTime();
+  btc.loadRateDatabase(dbPath);
+  report(results, config, "load", config.rows, dbBytes, getTime() - start);
+
+  // Parse and validate
+  start = getTime();
+  std::vector<Query> queries;
+  queries.reserve(config.lines);
+  std::ifstream infile(inputPath.c_str());
+  std::string line;
+  std::getline(infile, line);
+  while (std::getline(infile, line)) {
+    queries.push_back(Query());
+    btc.parseQuery(line, queries.back());
+  }
+  report(results, config, "parse", queries.size(), inputBytes, getTime() - start);
+
+  // Lookup
+  start = getTime();
+  unsigned long valid = 0, dateBytes = 0;
+  for (std::size_t i = 0; i < queries.size(); ++i)
+    if (queries[i].error.empty()) {
+      btc.valueQuery(queries[i], btc.findDate(queries[i].date));
+      dateBytes += queries[i].date.size();
+      ++valid;
+    }
+  report(results, config, "lookup", valid, dateBytes, getTime() - start);
+
+  // Output
+  start = getTime();
+  std::ostringstream os;
+  for (std::size_t i = 0; i < queries.size(); ++i) {
+    btc.writeQuery(os, queries[i]);
+    os << '\n';
+  }
+  std::string output = os.str();
+  report(results, config, "output", queries.size(), output.size(), getTime() - start);
+}
+
+static unsigned long parseCount(const std::string& str) {
+  char* endptr;
+  errno = 0;
+  unsigned long n = std::strtoul(str.c_str(), &endptr, 10);
+  if (errno || endptr == str.c_str() || *endptr || n == 0)
+    throw std::runtime_error("invalid count => " + str);
+  return n;
+}
+
+static void parseOption(Config& config, const std::string& arg) {
+  std::string::size_type eq = arg.find('=');
+  if (arg.compare(0, 2, "--") || eq == std::string::npos)
+    throw std::runtime_error("bad option => " + arg);
+  std::string name = arg.substr(2, eq - 2);
+  std::string value = arg.substr(eq + 1);
+  if (name == "rows")
+    config.rows = parseCount(value);
+  else if (name == "lines")
+    config.lines = parseCount(value);
+  else if (name == "seed")
+    config.seed = parseCount(value);
+  else if (name == "dir")
+    config.dir = value;
+  else if (name == "out")
+    config.out = value;
+  else if (name == "dates" && (value == "sorted" || value == "random" || value == "clustered"))
+    config.dates = value;
+  else if (name == "invalid") {
+    std::stringstream ss(value);
+    if (!(ss >> config.invalid) || !ss.eof() || config.invalid < 0 || config.invalid > 1)
+      throw std::runtime_error("bad option => " + arg);
+  } else
+    throw std::runtime_error("bad option => " + arg);
+}
+
+// Results go to 'path' through a temporary file, so a failed or interrupted
+// run never leaves partial results behind
+static void writeResults(const std::string& path, const std::string& results) {
+  std::string tmp = path + ".tmp";
+  writeFile(tmp, results);
+  if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+    std::remove(tmp.c_str());
+    throw std::runtime_error("could not write " + path);
+  }
+}
+
+int main(int ac, char **av) {
+  Config config;
+  try {
+    bool sweep = true;
+    for (int i = 1; i < ac; ++i) {
+      parseOption(config, av[i]);
+      if (std::string(av[i]).compare(0, 6, "--out="))
+        sweep = false;
+    }
+    if (!config.out.empty())
+      std::remove(config.out.c_str());
+
+    std::ostringstream results;
+    results << "# stage\tdates\trows\tinput_lines\tinvalid\tlines\tbytes\tus"
+               "\tlines_per_s\tbytes_per_s\n";
+    std::cout << results.str() << std::flush;
+    if (!sweep)
+      bench(config, results);
+    static const char* const dates[] = {"sorted", "random", "clustered"};
+    static const unsigned long lines[] = {10000, 100000, 1000000};
+    for (std::size_t d = 0; sweep && d < sizeof(dates) / sizeof(dates[0]); ++d)
+      for (std::size_t l = 0; l < sizeof(lines) / sizeof(lines[0]); ++l) {
+        Config run;
+        run.dates = dates[d];
+        run.lines = lines[l];
+        bench(run, results);
+      }
+    if (!config.out.empty())
+      writeResults(config.out, results.str());
+  } catch (const std::exception& e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    if (!config.out.empty())
+      std::remove(config.out.c_str());
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,31 @@
+
+#include "Server.hpp"
+
+#include <stdexcept>
+
+static volatile std::sig_atomic_t g_stop = 0;
+
+static void handleStop(int) {
+  g_stop = 1;
+}
+
+int main(int ac, char **av) {
+  if (ac != 2 && ac != 3) {
+    std::cerr << "Usage: " << av[0] << " socket [database]" << std::endl;
+    return 1;
+  }
+
+  BitcoinExchange btc;
+  btc.loadRateDatabase(ac == 3 ? av[2] : "data.csv");
+
+  std::signal(SIGINT, handleStop);
+  std::signal(SIGTERM, handleStop);
+  try {
+    Server server(btc, av[1]);
+    server.run(g_stop);
+  } catch (const std::exception& e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
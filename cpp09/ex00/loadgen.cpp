@@ -0,0 +1,225 @@
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Load generator for btcd: 'clients' processes each open a connection and
+// send 'queries' random "date,value" lines, 'depth' of them in flight at a
+// time. A query's latency runs from the send of its window to the arrival of
+// its answer line; qps counts every answer over the span from the first
+// client's start to the last one's end.
+// Output: one tab separated line, after a header line.
+
+struct Summary {
+  unsigned long start;
+  unsigned long end;
+  unsigned long errors;
+  unsigned long count;
+};
+
+static unsigned long now() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000UL + ts.tv_nsec / 1000;
+}
+
+static unsigned long parseCount(const char* str) {
+  char* endptr;
+  errno = 0;
+  unsigned long n = std::strtoul(str, &endptr, 10);
+  if (errno || endptr == str || *endptr || n == 0)
+    throw std::runtime_error(std::string("invalid count => ") + str);
+  return n;
+}
+
+static void writeAll(int fd, const char* data, std::size_t size) {
+  while (size > 0) {
+    ssize_t n = ::write(fd, data, size);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      throw std::runtime_error(std::string("write: ") + std::strerror(errno));
+    data += n;
+    size -= n;
+  }
+}
+
+// Reads until EOF; false if nothing at all could be read
+static bool readAll(int fd, std::string& data) {
+  char buffer[65536];
+  for (;;) {
+    ssize_t n = ::read(fd, buffer, sizeof(buffer));
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return !data.empty();
+    data.append(buffer, n);
+  }
+}
+
+static int connectTo(const std::string& path) {
+  sockaddr_un addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (path.empty() || path.size() >= sizeof(addr.sun_path))
+    throw std::runtime_error("invalid socket path => " + path);
+  std::memcpy(addr.sun_path, path.c_str(), path.size());
+  int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+    throw std::runtime_error("connect: " + path + ": " + std::strerror(errno));
+  return fd;
+}
+
+static void appendQuery(std::string& text) {
+  char line[64];
+  std::sprintf(line, "%04d-%02d-%02d,%d.%02d\n", 2009 + std::rand() % 14,
+               1 + std::rand() % 12, 1 + std::rand() % 28, std::rand() % 1000,
+               std::rand() % 100);
+  text += line;
+}
+
+// One client: sends its queries window by window, then reports its summary
+// and latencies through 'out'
+static void client(const std::string& path, unsigned long queries,
+                   unsigned long depth, int out) {
+  int fd = connectTo(path);
+  Summary summary;
+  std::memset(&summary, 0, sizeof(summary));
+  std::vector<unsigned long> latencies;
+  latencies.reserve(queries);
+  std::string text;
+  char buffer[65536];
+  bool lineStart = true;
+
+  summary.start = now();
+  for (unsigned long sent = 0; sent < queries;) {
+    unsigned long window = std::min(depth, queries - sent);
+    text.clear();
+    for (unsigned long i = 0; i < window; ++i)
+      appendQuery(text);
+    unsigned long start = now();
+    writeAll(fd, text.data(), text.size());
+    sent += window;
+
+    while (latencies.size() < sent) {
+      ssize_t n = ::read(fd, buffer, sizeof(buffer));
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        throw std::runtime_error("server closed the connection");
+      unsigned long arrival = now();
+      for (ssize_t i = 0; i < n; ++i) {
+        if (lineStart && buffer[i] == 'E')
+          ++summary.errors;
+        lineStart = buffer[i] == '\n';
+        if (lineStart)
+          latencies.push_back(arrival - start);
+      }
+    }
+  }
+  summary.end = now();
+  summary.count = latencies.size();
+  ::close(fd);
+
+  writeAll(out, reinterpret_cast<const char*>(&summary), sizeof(summary));
+  if (!latencies.empty())
+    writeAll(out, reinterpret_cast<const char*>(&latencies[0]),
+             latencies.size() * sizeof(latencies[0]));
+}
+
+static unsigned long percentile(const std::vector<unsigned long>& sorted, unsigned p) {
+  if (sorted.empty())
+    return 0;
+  return sorted[(sorted.size() - 1) * p / 100];
+}
+
+int main(int ac, char **av) {
+  if (ac < 2 || ac > 5) {
+    std::cerr << "Usage: " << av[0] << " socket [clients] [queries] [depth]" << std::endl;
+    return 1;
+  }
+
+  try {
+    std::string path = av[1];
+    unsigned long clients = ac > 2 ? parseCount(av[2]) : 4;
+    unsigned long queries = ac > 3 ? parseCount(av[3]) : 10000;
+    unsigned long depth = ac > 4 ? parseCount(av[4]) : 16;
+
+    std::vector<int> pipes;
+    std::vector<pid_t> pids;
+    for (unsigned long i = 0; i < clients; ++i) {
+      int fds[2];
+      if (::pipe(fds) < 0)
+        throw std::runtime_error(std::string("pipe: ") + std::strerror(errno));
+      std::cout.flush();
+      pid_t pid = ::fork();
+      if (pid < 0)
+        throw std::runtime_error(std::string("fork: ") + std::strerror(errno));
+      if (pid == 0) {
+        ::close(fds[0]);
+        std::srand(::getpid());
+        try {
+          client(path, queries, depth, fds[1]);
+        } catch (const std::exception& e) {
+          std::cerr << "Error: " << e.what() << std::endl;
+          std::exit(EXIT_FAILURE);
+        }
+        std::exit(EXIT_SUCCESS);
+      }
+      ::close(fds[1]);
+      pipes.push_back(fds[0]);
+      pids.push_back(pid);
+    }
+
+    // Gather every client's latencies, then the overall figures
+    std::vector<unsigned long> latencies;
+    unsigned long start = 0, end = 0, errors = 0;
+    bool failed = false;
+    for (std::size_t i = 0; i < pipes.size(); ++i) {
+      std::string data;
+      bool ok = readAll(pipes[i], data) && data.size() >= sizeof(Summary);
+      ::close(pipes[i]);
+      int status;
+      if (::waitpid(pids[i], &status, 0) < 0 || !WIFEXITED(status) ||
+          WEXITSTATUS(status) != EXIT_SUCCESS || !ok) {
+        failed = true;
+        continue;
+      }
+      Summary summary;
+      std::memcpy(&summary, data.data(), sizeof(summary));
+      const unsigned long* first =
+          reinterpret_cast<const unsigned long*>(data.data() + sizeof(summary));
+      latencies.insert(latencies.end(), first, first + summary.count);
+      if (latencies.size() == summary.count || summary.start < start)
+        start = summary.start;
+      end = std::max(end, summary.end);
+      errors += summary.errors;
+    }
+    if (failed || latencies.empty())
+      throw std::runtime_error("a client failed");
+
+    std::sort(latencies.begin(), latencies.end());
+    double seconds = (end - start) / 1e6;
+    std::cout << "# clients\tdepth\tqueries\terrors\tqps\tp50_us\tp99_us\tmax_us" << std::endl;
+    std::cout << clients << '\t' << depth << '\t' << latencies.size() << '\t' << errors << '\t'
+              << static_cast<unsigned long>(seconds > 0 ? latencies.size() / seconds : 0)
+              << '\t' << percentile(latencies, 50) << '\t' << percentile(latencies, 99)
+              << '\t' << latencies.back() << std::endl;
+  } catch (const std::exception& e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
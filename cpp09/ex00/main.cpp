@@ -2,7 +2,7 @@
 #include "BitcoinExchange.hpp"
 
 int main(int ac, char **av) {
-  if (ac != 2){
+  if (ac != 2 && ac != 3){
     std::cerr << "Error: could not open file." << std::endl;
     return 1;
   }
@@ -10,6 +10,13 @@ int main(int ac, char **av) {
   BitcoinExchange btc;
   btc.loadRateDatabase("data.csv");
 
+  // Optional quote asset: values are converted into it
+  std::size_t quote = BitcoinExchange::npos;
+  if (ac == 3 && (quote = btc.findAsset(av[2])) == BitcoinExchange::npos) {
+    std::cerr << "Error: unknown asset => " << av[2] << std::endl;
+    return 1;
+  }
+
   std::ifstream infile(av[1]);
   if (!infile.is_open()) {
     std::cerr << "Error: could not open file." << std::endl;
@@ -19,33 +26,13 @@ int main(int ac, char **av) {
   std::string line;
   std::getline(infile, line);
 
+  Query query;
   while (std::getline(infile, line)) {
-    std::stringstream ss(line);
-    std::string date, valueStr;
-
-    if (!std::getline(ss, date, ',') || !std::getline(ss, valueStr)) {
-      std::cerr << "Error: bad input => " << line << std::endl;
-      continue;
-    }
-
-    date.erase(0, date.find_first_not_of(" \t"));
-    date.erase(date.find_last_not_of(" \t") + 1);
-    valueStr.erase(0, valueStr.find_first_not_of(" \t"));
-    valueStr.erase(valueStr.find_last_not_of(" \t") + 1);
-
-    double value;
-    if (!btc.isValidDate(date)) {
-      std::cerr << "Error: bad input => " << date << std::endl;
-      continue;
-    } else if (!btc.isValidValue(valueStr, value)) {
-      if (value < 0)
-        std::cerr << "Error: not a positive number." << std::endl;
-      else 
-        std::cerr << "Error: too large a number." << std::endl;
-      continue;
-    }
-    double rate = btc.getRateBydata(date);
-    std::cout << date << "=>" << value << " = " << (value * rate) << std::endl;
+    if (btc.parseQuery(line, query))
+      btc.valueQuery(query, btc.findDate(query.date), quote);
+    std::ostream& os = query.error.empty() ? std::cout : std::cerr;
+    btc.writeQuery(os, query, quote);
+    os << std::endl;
   }
   return 0;
-}
\ No newline at end of file
+}
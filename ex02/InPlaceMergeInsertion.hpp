@@ -0,0 +1,154 @@
+
+#pragma once
+#ifndef __INPLACEMERGEINSERTION_HPP__
+#define __INPLACEMERGEINSERTION_HPP__
+
+#include "Metrics.hpp"
+#include "PmergeMe.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+
+// Merge-insertion on a random access range with O(log n) extra space.
+//
+// Pairs are kept by position ("pair-swap" layout): at a level of size m with
+// h = m / 2, position i < h holds the larger element of a pair whose smaller
+// element sits at i + h, and an odd element stays at 2h. The recursion sorts
+// [0, h), so every swap or rotation a level makes at position i is repeated
+// at i plus each sum of the enclosing levels' halves; that is where the
+// partners tied to i by the outer levels live. Only those halves are stored,
+// one per level.
+//
+// The insertion order is Ford-Johnson's, and each binary search of a group
+// spans the 2^k - 1 elements the algorithm bounds it by, so the worst-case
+// comparison count is the same. The search does not stop at the partner as
+// in MergeInsertion, whose position is not tracked here, so on average a few
+// more comparisons are made.
+template <typename RandomIt, typename Metrics> class InPlaceMergeInsertion {
+private:
+  RandomIt _first;
+  Metrics &_metrics;
+  std::size_t _halves[sizeof(std::size_t) * CHAR_BIT];
+  std::size_t _depth;
+
+  InPlaceMergeInsertion(InPlaceMergeInsertion const &);
+  InPlaceMergeInsertion &operator=(InPlaceMergeInsertion const &);
+
+  bool less(std::size_t i, std::size_t j) {
+    _metrics.compare();
+    return _first[i] < _first[j];
+  };
+
+  // Swaps positions i and j in the first 'level' enclosing copies
+  void swapAll(std::size_t i, std::size_t j, std::size_t level) {
+    if (level == 0) {
+      std::iter_swap(_first + i, _first + j);
+      _metrics.move(3);
+      return;
+    }
+    swapAll(i, j, level - 1);
+    swapAll(i + _halves[level - 1], j + _halves[level - 1], level - 1);
+  };
+
+  // Moves position 'hi' down to 'lo', shifting [lo, hi) up by one
+  void rotateAll(std::size_t lo, std::size_t hi, std::size_t level) {
+    if (level == 0) {
+      std::rotate(_first + lo, _first + hi, _first + hi + 1);
+      _metrics.move(hi - lo + 1);
+      return;
+    }
+    rotateAll(lo, hi, level - 1);
+    rotateAll(lo + _halves[level - 1], hi + _halves[level - 1], level - 1);
+  };
+
+  // First position in [0, len) whose element is not less than 'key'
+  std::size_t lowerBound(std::size_t len, std::size_t key) {
+    std::size_t lo = 0;
+    while (len > 0) {
+      std::size_t half = len / 2;
+      if (less(lo + half, key)) {
+        lo += half + 1;
+        len -= half + 1;
+      } else
+        len = half;
+    }
+    return lo;
+  };
+
+  // Binary-inserts the element at 'from' into the chain [0, len)
+  void insert(std::size_t len, std::size_t from) {
+    std::size_t pos = lowerBound(len, from);
+    rotateAll(pos, from, _depth);
+  };
+
+  void mergeInsert(std::size_t size, std::size_t half) {
+    // b0 is not above a0, which is the smallest of the sorted chain
+    rotateAll(0, half, _depth);
+    std::size_t chain = half + 1;
+    bool odd = size % 2;
+
+    std::size_t done = 0;
+    for (std::size_t n = 1; done + 1 < half; ++n) {
+      std::size_t group = done + 2 * jacobsthal(n);
+      std::size_t top = group < half ? group : half - 1;
+      // The search window: everything before a(top) when b(top) goes in
+      std::size_t bound = top + done + 1;
+      if (group >= half && odd) {
+        insert(chain, size - 1);
+        ++chain;
+        ++bound;
+        odd = false;
+      }
+      // b(done + 1) .. b(top) wait at [chain, ...) in index order
+      for (std::size_t k = top; k > done; --k) {
+        insert(bound, chain + (k - done - 1));
+        ++chain;
+      }
+      done = top;
+    }
+    if (odd)
+      insert(chain, size - 1);
+  };
+
+  void sort(std::size_t size) {
+    if (size < 2)
+      return;
+    std::size_t half = size / 2;
+
+    // Pairing phase: the larger of (i, i + half) moves to i
+    _metrics.enter(PHASE_PAIRING, _depth);
+    for (std::size_t i = 0; i < half; ++i)
+      if (less(i, i + half))
+        swapAll(i, i + half, _depth);
+    _metrics.leave();
+
+    // Recursive sort on the larger half
+    _metrics.enter(PHASE_RECURSION, _depth);
+    _halves[_depth++] = half;
+    sort(half);
+    --_depth;
+    _metrics.leave();
+
+    // Merge-insert phase
+    _metrics.enter(PHASE_MERGE_INSERT, _depth);
+    mergeInsert(size, half);
+    _metrics.leave();
+  };
+
+public:
+  InPlaceMergeInsertion(RandomIt first, Metrics &metrics)
+      : _first(first), _metrics(metrics), _depth(0) {};
+  ~InPlaceMergeInsertion() {};
+
+  void run(std::size_t size) {
+    sort(size);
+  };
+};
+
+template <typename RandomIt, typename Metrics>
+void sortInPlace(RandomIt first, RandomIt last, Metrics &metrics) {
+  InPlaceMergeInsertion<RandomIt, Metrics>(first, metrics).run(last - first);
+}
+
+#endif
@@ -0,0 +1,401 @@
+
+#pragma once
+#ifndef __MERGEINSERTION_HPP__
+#define __MERGEINSERTION_HPP__
+
+#include "Metrics.hpp"
+#include "PmergeMe.hpp"
+#include "SmallSort.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <deque>
+#include <iterator>
+#include <list>
+#include <stdexcept>
+#include <vector>
+
+// Functor to wrap comparisons and report them to the metrics policy
+template <typename NodeType, typename Metrics>
+struct CompareNode {
+  Metrics *metrics;
+
+  explicit CompareNode(Metrics &m) : metrics(&m) {};
+  bool operator()(NodeType const &a, NodeType const &b) const {
+    metrics->compare();
+    return a < b;
+  };
+};
+
+template <typename T> void reserveSequence(std::vector<T> &seq, std::size_t n) {
+  seq.reserve(n);
+}
+
+template <typename T> void reserveSequence(std::deque<T> &, std::size_t) {}
+
+// Elements shifted by an insertion at 'pos': a vector always moves the tail,
+// a deque moves whichever side is shorter.
+template <typename T>
+std::size_t shiftedBy(std::vector<T> &seq,
+                      typename std::vector<T>::iterator pos) {
+  return seq.end() - pos;
+}
+
+template <typename T>
+std::size_t shiftedBy(std::deque<T> &seq, typename std::deque<T>::iterator pos) {
+  return std::min(pos - seq.begin(), seq.end() - pos);
+}
+
+// Chain of the merge-insert phase on top of a random access container.
+// Insertions invalidate iterators, so the anchor is carried across by index.
+template <typename Sequence> class SequenceChain {
+private:
+  Sequence _nodes;
+
+  SequenceChain(SequenceChain const &);
+  SequenceChain &operator=(SequenceChain const &);
+
+public:
+  typedef typename Sequence::value_type value_type;
+  typedef typename Sequence::iterator iterator;
+
+  SequenceChain() {};
+  ~SequenceChain() {};
+
+  template <typename Metrics> void reserve(std::size_t n, Metrics &metrics) {
+    reserveSequence(_nodes, n);
+    metrics.allocate(n * sizeof(value_type));
+  };
+  iterator begin() {
+    return _nodes.begin();
+  };
+  iterator end() {
+    return _nodes.end();
+  };
+  template <typename Metrics>
+  void push_back(value_type const &value, Metrics &metrics) {
+    _nodes.push_back(value);
+    metrics.move(1);
+  };
+  // Inserts before 'pos' and returns 'anchor' as seen after the insertion
+  template <typename Metrics>
+  iterator insert(iterator pos, value_type const &value, iterator anchor,
+                  Metrics &metrics) {
+    std::size_t index = anchor - _nodes.begin();
+    if (pos <= anchor)
+      ++index;
+    metrics.move(shiftedBy(_nodes, pos) + 1);
+    _nodes.insert(pos, value);
+    return _nodes.begin() + index;
+  };
+};
+
+// Chain of the merge-insert phase as a doubly linked list whose links all
+// come from one pool reserved up front: an insertion splices a link in and
+// never allocates, and no iterator is ever invalidated.
+template <typename Type> class LinkedChain {
+private:
+  struct Link {
+    Node<Type> value;
+    Link *prev;
+    Link *next;
+
+    Link(Node<Type> const &value = Node<Type>())
+        : value(value), prev(NULL), next(NULL) {};
+  };
+
+  std::vector<Link> _pool;
+  Link _head;
+
+  LinkedChain(LinkedChain const &);
+  LinkedChain &operator=(LinkedChain const &);
+
+  Link *acquire(Node<Type> const &value) {
+    if (_pool.size() == _pool.capacity())
+      throw std::length_error("LinkedChain");
+    _pool.push_back(Link(value));
+    return &_pool.back();
+  };
+  static void splice(Link *before, Link *link) {
+    link->prev = before->prev;
+    link->next = before;
+    before->prev->next = link;
+    before->prev = link;
+  };
+
+public:
+  typedef Node<Type> value_type;
+
+  class iterator
+      : public std::iterator<std::bidirectional_iterator_tag, Node<Type> > {
+  private:
+    Link *_link;
+
+  public:
+    iterator(Link *link = NULL) : _link(link) {};
+    Node<Type> &operator*() const {
+      return _link->value;
+    };
+    Node<Type> *operator->() const {
+      return &_link->value;
+    };
+    iterator &operator++() {
+      _link = _link->next;
+      return *this;
+    };
+    iterator operator++(int) {
+      iterator tmp(*this);
+      _link = _link->next;
+      return tmp;
+    };
+    iterator &operator--() {
+      _link = _link->prev;
+      return *this;
+    };
+    iterator operator--(int) {
+      iterator tmp(*this);
+      _link = _link->prev;
+      return tmp;
+    };
+    bool operator==(iterator const &rhs) const {
+      return _link == rhs._link;
+    };
+    bool operator!=(iterator const &rhs) const {
+      return _link != rhs._link;
+    };
+    Link *link() const {
+      return _link;
+    };
+  };
+
+  LinkedChain() {
+    _head.prev = &_head;
+    _head.next = &_head;
+  };
+  ~LinkedChain() {};
+
+  template <typename Metrics> void reserve(std::size_t n, Metrics &metrics) {
+    _pool.reserve(n);
+    metrics.allocate(n * sizeof(Link));
+  };
+  iterator begin() {
+    return iterator(_head.next);
+  };
+  iterator end() {
+    return iterator(&_head);
+  };
+  template <typename Metrics>
+  void push_back(value_type const &value, Metrics &metrics) {
+    splice(&_head, acquire(value));
+    metrics.move(1);
+  };
+  template <typename Metrics>
+  iterator insert(iterator pos, value_type const &value, iterator anchor,
+                  Metrics &metrics) {
+    splice(pos.link(), acquire(value));
+    metrics.move(1);
+    return anchor;
+  };
+};
+
+// Merge-insertion (Ford-Johnson) over any forward range. The sorted order is
+// produced in 'out' as Nodes pointing at the range's elements; the caller
+// decides how to move the elements themselves. 'Chain' is the structure the
+// insertions go into and is shared by every recursion level.
+template <typename Chain, typename Metrics> class MergeInsertion {
+private:
+  typedef typename Chain::value_type NodeType;
+  typedef typename Chain::iterator ChainIterator;
+  typedef CompareNode<NodeType, Metrics> Compare;
+
+  static NodeType &unwrap(NodeType &wrapper) {
+    NodeType *node;
+    wrapper.getValue(node);
+    return *node;
+  };
+
+  // Small subproblems: SmallSort over pointers on the stack, with the same
+  // comparisons the general case would make
+  template <typename Iterator>
+  static void runSmall(Iterator first, std::size_t size, Chain &out,
+                       Metrics &metrics, std::size_t depth) {
+    typedef typename std::iterator_traits<Iterator>::value_type Element;
+    Element *keys[SMALL_SORT_MAX] = {0}, *sorted[SMALL_SORT_MAX] = {0};
+    for (std::size_t i = 0; i < size; ++i, ++first)
+      keys[i] = &*first;
+    metrics.enter(PHASE_SMALL_SORT, depth);
+    smallSort(keys, sorted, size, metrics);
+    for (std::size_t i = 0; i < size; ++i)
+      out.push_back(NodeType(sorted[i]), metrics);
+    metrics.leave();
+  };
+
+public:
+  template <typename Iterator>
+  static void run(Iterator first, std::size_t size, Chain &out,
+                  Metrics &metrics, std::size_t depth = 0) {
+    out.reserve(size, metrics);
+    if (size <= SMALL_SORT_MAX) {
+      runSmall(first, size, out, metrics, depth);
+      return;
+    }
+
+    // Pairing phase
+    metrics.enter(PHASE_PAIRING, depth);
+    std::vector<NodeType> large, small;
+    large.reserve(size / 2);
+    small.reserve(size / 2 + size % 2);
+    metrics.allocate((large.capacity() + small.capacity()) * sizeof(NodeType));
+    Iterator it = first;
+    for (std::size_t i = 1; i < size; i += 2) {
+      Iterator pre = it++;
+      metrics.compare();
+      bool isLess = *pre < *it;
+      large.push_back(isLess ? &*it : &*pre);
+      small.push_back(isLess ? &*pre : &*it);
+      large.back().push(&small.back());
+      metrics.move(2);
+      ++it;
+    }
+    if (size % 2) {
+      small.push_back(&*it);
+      metrics.move(1);
+    }
+    metrics.leave();
+
+    // Recursive sort on 'large'
+    metrics.enter(PHASE_RECURSION, depth);
+    Chain sorted;
+    run(large.begin(), large.size(), sorted, metrics, depth + 1);
+    metrics.leave();
+
+    // Merge-insert phase
+    metrics.enter(PHASE_MERGE_INSERT, depth);
+    ChainIterator jt = sorted.begin();
+    out.push_back(*unwrap(*jt).pop(), metrics);
+    out.push_back(unwrap(*jt), metrics);
+    ++jt;
+
+    bool finished = false;
+    for (std::size_t n = 1; !finished; ++n) {
+      // Take the next 2*J(n) elements from 'large'
+      for (std::size_t j = 2 * jacobsthal(n); j > 0; --j) {
+        if (jt == sorted.end()) {
+          // If odd count, insert the leftover from 'small'
+          if (size % 2) {
+            NodeType &node = small.back();
+            out.insert(std::lower_bound(out.begin(), out.end(), node,
+                                        Compare(metrics)),
+                       node, out.end(), metrics);
+          }
+          finished = true;
+          break;
+        }
+        out.push_back(unwrap(*jt), metrics);
+        ++jt;
+      }
+      // Now insert paired elements, each below its partner
+      for (ChainIterator kt = out.end(); kt != out.begin();) {
+        if ((--kt)->hasPair()) {
+          NodeType &node = *kt->pop();
+          kt = out.insert(
+              std::lower_bound(out.begin(), kt, node, Compare(metrics)), node,
+              kt, metrics);
+        }
+      }
+    }
+    metrics.leave();
+  };
+};
+
+// Picks the chain for a container: random access containers shift a vector,
+// bidirectional ones splice a linked chain, and std::deque keeps a deque so
+// insertions near the front only shift the short side.
+template <typename Container,
+          typename Category = typename std::iterator_traits<
+              typename Container::iterator>::iterator_category>
+struct SortTraits {
+  typedef typename TypeSelector<typename Container::value_type>::type Type;
+  typedef LinkedChain<Type> Chain;
+};
+
+template <typename Container>
+struct SortTraits<Container, std::random_access_iterator_tag> {
+  typedef typename TypeSelector<typename Container::value_type>::type Type;
+  typedef SequenceChain<std::vector<Node<Type> > > Chain;
+};
+
+template <typename T>
+struct SortTraits<std::deque<T>, std::random_access_iterator_tag> {
+  typedef typename TypeSelector<T>::type Type;
+  typedef SequenceChain<std::deque<Node<Type> > > Chain;
+};
+
+// Contiguous range: the elements are permuted in place along the cycles of
+// the sorted order. The cycles are walked through the chain itself, each
+// entry being pointed back at its own slot once that slot is filled, so the
+// chain is the only memory used besides the range.
+template <typename T, typename Metrics>
+void sortArray(T *first, T *last, Metrics &metrics) {
+  typedef SequenceChain<std::vector<Node<T> > > Chain;
+  std::size_t size = last - first;
+  Chain chain;
+  MergeInsertion<Chain, Metrics>::run(first, size, chain, metrics);
+
+  // Extract sorted values
+  metrics.enter(PHASE_EXTRACTION, 0);
+  typename Chain::iterator order = chain.begin();
+  T *source;
+  for (std::size_t i = 0; i < size; ++i) {
+    order[i].getValue(source);
+    if (source == first + i)
+      continue;
+    T tmp = first[i];
+    std::size_t j = i;
+    for (; (source - first) != static_cast<std::ptrdiff_t>(i);
+         order[j].getValue(source)) {
+      std::size_t k = source - first;
+      first[j] = *source;
+      order[j] = Node<T>(first + j);
+      metrics.move(1);
+      j = k;
+    }
+    first[j] = tmp;
+    order[j] = Node<T>(first + j);
+    metrics.move(2);
+  }
+  metrics.leave();
+}
+
+template <typename T, typename Metrics>
+void sort(std::vector<T> &data, Metrics &metrics) {
+  if (!data.empty())
+    sortArray(&data[0], &data[0] + data.size(), metrics);
+}
+
+// Any other container: the sorted values are gathered once and assigned back
+// through the container's own storage, so no element or node is reallocated.
+template <typename Container, typename Metrics>
+void sort(Container &data, Metrics &metrics) {
+  typedef typename Container::value_type T;
+  typedef typename SortTraits<Container>::Chain Chain;
+  Chain chain;
+  MergeInsertion<Chain, Metrics>::run(data.begin(), data.size(), chain,
+                                      metrics);
+
+  // Extract sorted values
+  metrics.enter(PHASE_EXTRACTION, 0);
+  std::vector<T> res;
+  res.reserve(data.size());
+  metrics.allocate(res.capacity() * sizeof(T));
+  for (typename Chain::iterator it = chain.begin(); it != chain.end(); ++it) {
+    T *value;
+    it->getValue(value);
+    res.push_back(*value);
+  }
+  std::copy(res.begin(), res.end(), data.begin());
+  metrics.move(2 * res.size());
+  metrics.leave();
+}
+
+#endif
@@ -0,0 +1,223 @@
+// Metrics.cpp
+#include "Metrics.hpp"
+
+#include <ctime>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+
+unsigned long readCycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __builtin_ia32_rdtsc();
+#else
+  return readNanoseconds();
+#endif
+}
+
+unsigned long readNanoseconds()
+{
+  timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1000000000UL + t.tv_nsec;
+}
+
+char const *phaseName(Phase phase)
+{
+  static char const *const names[PHASE_COUNT] = {
+      "pairing", "recursion", "merge-insert", "extraction", "small-sort"};
+  return names[phase];
+}
+
+PhaseMetrics::Counters::Counters()
+    : calls(0), comparisons(0), moves(0), bytes(0), cycles(0), nanoseconds(0)
+{
+}
+
+PhaseMetrics::PhaseMetrics(std::string const &label) : _label(label)
+{
+}
+
+PhaseMetrics::PhaseMetrics(PhaseMetrics const &rhs)
+    : _label(rhs._label), _stack(rhs._stack), _events(rhs._events),
+      _outside(rhs._outside)
+{
+  for (int i = 0; i < PHASE_COUNT; ++i)
+    _levels[i] = rhs._levels[i];
+}
+
+PhaseMetrics::~PhaseMetrics()
+{
+}
+
+PhaseMetrics &PhaseMetrics::operator=(PhaseMetrics const &rhs)
+{
+  if (this != &rhs)
+  {
+    _label = rhs._label;
+    for (int i = 0; i < PHASE_COUNT; ++i)
+      _levels[i] = rhs._levels[i];
+    _stack = rhs._stack;
+    _events = rhs._events;
+    _outside = rhs._outside;
+  }
+  return *this;
+}
+
+void PhaseMetrics::enter(Phase phase, std::size_t depth)
+{
+  if (_levels[phase].size() <= depth)
+    _levels[phase].resize(depth + 1);
+  ++_levels[phase][depth].calls;
+
+  Frame frame;
+  frame.phase = phase;
+  frame.depth = depth;
+  frame.event = _events.size();
+  frame.nanoseconds = readNanoseconds();
+  Event event;
+  event.phase = phase;
+  event.depth = depth;
+  event.begin = frame.nanoseconds;
+  event.end = frame.nanoseconds;
+  _events.push_back(event);
+  _stack.push_back(frame);
+  // Read last so the bookkeeping above is not charged to the phase.
+  _stack.back().cycles = readCycles();
+}
+
+void PhaseMetrics::leave()
+{
+  unsigned long cycles = readCycles();
+  if (_stack.empty())
+    throw std::logic_error("PhaseMetrics::leave");
+  Frame const &frame = _stack.back();
+  unsigned long nanoseconds = readNanoseconds();
+  Counters &counters = _levels[frame.phase][frame.depth];
+  counters.cycles += cycles - frame.cycles;
+  counters.nanoseconds += nanoseconds - frame.nanoseconds;
+  _events[frame.event].end = nanoseconds;
+  _stack.pop_back();
+}
+
+std::string const &PhaseMetrics::label() const
+{
+  return _label;
+}
+
+std::size_t PhaseMetrics::depth() const
+{
+  std::size_t depth = 0;
+  for (int i = 0; i < PHASE_COUNT; ++i)
+    if (depth < _levels[i].size())
+      depth = _levels[i].size();
+  return depth;
+}
+
+PhaseMetrics::Counters const &PhaseMetrics::at(Phase phase, std::size_t depth) const
+{
+  static Counters const empty;
+  if (depth < _levels[phase].size())
+    return _levels[phase][depth];
+  return empty;
+}
+
+PhaseMetrics::Counters PhaseMetrics::total(Phase phase) const
+{
+  Counters sum;
+  for (std::size_t d = 0; d < _levels[phase].size(); ++d)
+  {
+    Counters const &c = _levels[phase][d];
+    sum.calls += c.calls;
+    sum.comparisons += c.comparisons;
+    sum.moves += c.moves;
+    sum.bytes += c.bytes;
+    // Recursion intervals nest, so only the outermost one is wall time.
+    if (phase != PHASE_RECURSION || d == 0)
+    {
+      sum.cycles += c.cycles;
+      sum.nanoseconds += c.nanoseconds;
+    }
+  }
+  return sum;
+}
+
+std::vector<PhaseMetrics::Event> const &PhaseMetrics::events() const
+{
+  return _events;
+}
+
+static void reportRow(std::ostream &os, std::string const &label,
+                      char const *phase, char const *depth,
+                      PhaseMetrics::Counters const &c)
+{
+  os << label << '\t' << phase << '\t' << depth << '\t' << c.calls << '\t'
+     << c.comparisons << '\t' << c.moves << '\t' << c.bytes << '\t'
+     << c.cycles << '\t' << c.nanoseconds << std::endl;
+}
+
+// Tab separated, one row per phase and depth followed by a per-phase total
+// with depth "all". Recursion rows are inclusive of the deeper levels.
+void PhaseMetrics::report(std::ostream &os) const
+{
+  os << "# run\tphase\tdepth\tcalls\tcomparisons\tmoves\tbytes\tcycles\tns"
+     << std::endl;
+  for (int p = 0; p < PHASE_COUNT; ++p)
+  {
+    Phase phase = static_cast<Phase>(p);
+    for (std::size_t d = 0; d < _levels[p].size(); ++d)
+    {
+      std::ostringstream depth;
+      depth << d;
+      reportRow(os, _label, phaseName(phase), depth.str().c_str(),
+                _levels[p][d]);
+    }
+    reportRow(os, _label, phaseName(phase), "all", total(phase));
+  }
+}
+
+static void writeJsonString(std::ostream &os, std::string const &s)
+{
+  os << '"';
+  for (std::string::const_iterator it = s.begin(); it != s.end(); ++it)
+  {
+    if (*it == '"' || *it == '\\')
+      os << '\\';
+    os << *it;
+  }
+  os << '"';
+}
+
+void writeTrace(std::ostream &os, std::vector<PhaseMetrics const *> const &runs)
+{
+  unsigned long origin = 0;
+  for (std::size_t r = 0; r < runs.size(); ++r)
+    if (!runs[r]->events().empty() &&
+        (origin == 0 || runs[r]->events().front().begin < origin))
+      origin = runs[r]->events().front().begin;
+
+  os << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+  bool first = true;
+  for (std::size_t r = 0; r < runs.size(); ++r)
+  {
+    os << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\","
+       << "\"pid\":1,\"tid\":" << r + 1 << ",\"args\":{\"name\":";
+    writeJsonString(os, runs[r]->label());
+    os << "}}";
+    first = false;
+
+    std::vector<PhaseMetrics::Event> const &events = runs[r]->events();
+    for (std::size_t i = 0; i < events.size(); ++i)
+    {
+      PhaseMetrics::Event const &e = events[i];
+      os << ",\n{\"name\":\"" << phaseName(e.phase) << "\",\"cat\":\"depth "
+         << e.depth << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << r + 1
+         << ",\"ts\":" << std::fixed << std::setprecision(3)
+         << (e.begin - origin) / 1000.0 << ",\"dur\":"
+         << (e.end - e.begin) / 1000.0 << ",\"args\":{\"depth\":" << e.depth
+         << "}}";
+    }
+  }
+  os << "\n]}" << std::endl;
+}
@@ -0,0 +1,124 @@
+
+#pragma once
+#ifndef __METRICS_HPP__
+#define __METRICS_HPP__
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+unsigned long readCycles();
+unsigned long readNanoseconds();
+
+enum Phase {
+  PHASE_PAIRING,
+  PHASE_RECURSION,
+  PHASE_MERGE_INSERT,
+  PHASE_EXTRACTION,
+  PHASE_SMALL_SORT,
+  PHASE_COUNT
+};
+
+char const *phaseName(Phase phase);
+
+// Instrumentation policies for sort(). Each one provides the same hooks:
+//   compare()          one element comparison
+//   move(n)            n element copies or moves
+//   allocate(bytes)    bytes requested from the allocator
+//   enter(phase, depth) / leave()  brackets a phase of one recursion level
+// Counters are attributed to the innermost open phase.
+
+// Disabled: every hook is an empty inline function and vanishes at -O2.
+struct NullMetrics {
+  void compare() {}
+  void move(std::size_t) {}
+  void allocate(std::size_t) {}
+  void enter(Phase, std::size_t) {}
+  void leave() {}
+};
+
+// Comparison count only; what the plain timed run reports.
+struct CountMetrics : NullMetrics {
+  unsigned long comparisons;
+
+  CountMetrics() : comparisons(0) {}
+  void compare() {
+    ++comparisons;
+  }
+};
+
+// Full per-phase, per-depth counters plus a trace of every phase interval.
+class PhaseMetrics {
+public:
+  struct Counters {
+    unsigned long calls;
+    unsigned long comparisons;
+    unsigned long moves;
+    unsigned long bytes;
+    unsigned long cycles;
+    unsigned long nanoseconds;
+
+    Counters();
+  };
+
+  struct Event {
+    Phase phase;
+    std::size_t depth;
+    unsigned long begin;
+    unsigned long end;
+  };
+
+private:
+  struct Frame {
+    Phase phase;
+    std::size_t depth;
+    std::size_t event;
+    unsigned long cycles;
+    unsigned long nanoseconds;
+  };
+
+  std::string _label;
+  std::vector<Counters> _levels[PHASE_COUNT];
+  std::vector<Frame> _stack;
+  std::vector<Event> _events;
+  Counters _outside;
+
+  Counters &current() {
+    if (_stack.empty())
+      return _outside;
+    return _levels[_stack.back().phase][_stack.back().depth];
+  }
+
+public:
+  PhaseMetrics(std::string const &label);
+  PhaseMetrics(PhaseMetrics const &rhs);
+  ~PhaseMetrics();
+  PhaseMetrics &operator=(PhaseMetrics const &rhs);
+
+  void compare() {
+    ++current().comparisons;
+  }
+  void move(std::size_t n) {
+    current().moves += n;
+  }
+  void allocate(std::size_t bytes) {
+    current().bytes += bytes;
+  }
+  void enter(Phase phase, std::size_t depth);
+  void leave();
+
+  std::string const &label() const;
+  std::size_t depth() const;
+  Counters const &at(Phase phase, std::size_t depth) const;
+  Counters total(Phase phase) const;
+  std::vector<Event> const &events() const;
+
+  void report(std::ostream &os) const;
+};
+
+// Writes the phase intervals of every run as a Chrome trace-event JSON file
+// (chrome://tracing, ui.perfetto.dev), one track per run.
+void writeTrace(std::ostream &os, std::vector<PhaseMetrics const *> const &runs);
+
+#endif
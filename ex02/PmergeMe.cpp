@@ -1,26 +1,15 @@
 // PmergeMe.cpp
 #include "PmergeMe.hpp"
+#include "MergeInsertion.hpp"
+#include "Radix.hpp"
 
 #include <iostream>
 #include <iomanip>
+#include <fstream>
 #include <list>
 #include <vector>
+#include <stdexcept>
 #include <sys/time.h>
-#include <algorithm> // for std::lower_bound
-
-// Global counter for comparisons during insertions
-static unsigned long comparisonCount = 0;
-
-// Functor to wrap comparisons and increment the counter
-template <typename NodeType>
-struct CompareNode
-{
-  bool operator()(NodeType const &a, NodeType const &b) const
-  {
-    ++comparisonCount;
-    return a < b;
-  }
-};
 
 unsigned long getTime()
 {
@@ -50,199 +39,75 @@ unsigned long jacobsthal(unsigned long i)
   return buf[i];
 }
 
-template <typename T>
-void sort(std::vector<T> &data)
-{
-  if (data.size() < 2)
-    return;
-  typedef typename TypeSelector<T>::type Type;
-  std::vector<Node<Type> > large, small;
-  large.reserve(data.size() / 2);
-  small.reserve(data.size() / 2 + data.size() % 2);
-
-  // Pairing phase
-  for (typename std::vector<T>::iterator it = data.begin(); it != data.end(); ++it)
-  {
-    typename std::vector<T>::iterator pre = it++;
-    if (it == data.end())
-    {
-      small.push_back(&*pre);
-      break;
-    }
-    bool isLess = *pre < *it;
-    large.push_back(isLess ? &*it : &*pre);
-    small.push_back(isLess ? &*pre : &*it);
-    large.back().push(&small.back());
-  }
-
-  // Recursive sort on 'large'
-  sort(large);
-
-  // Merge-insert phase
-  std::vector<Node<Type> > tmp;
-  tmp.reserve(data.size());
-  {
-    bool finished = false;
-    typename std::vector<Node<Type> >::iterator it = large.begin();
-    tmp.push_back(*it->pop());
-    tmp.push_back(*it);
-    ++it;
-
-    for (std::size_t n = 1; !finished; ++n)
-    {
-      // Take the next 2*J(n) elements from 'large'
-      for (std::size_t j = 2 * jacobsthal(n); j > 0; --j)
-      {
-        if (it == large.end())
-        {
-          // If odd count, insert the leftover from 'small'
-          if (data.size() % 2)
-          {
-            Node<Type> &node = small.back();
-            tmp.insert(
-                std::lower_bound(tmp.begin(), tmp.end(), node, CompareNode<Node<Type> >()),
-                node);
-          }
-          finished = true;
-          break;
-        }
-        tmp.push_back(*it);
-        ++it;
-      }
-      // Now insert paired elements back into tmp
-      for (typename std::vector<Node<Type> >::reverse_iterator jt = tmp.rbegin();
-           jt != tmp.rend();)
-      {
-        if (jt->hasPair())
-        {
-          Node<Type> &node = *jt->pop();
-          tmp.insert(
-              std::lower_bound(tmp.begin(), --jt.base(), node, CompareNode<Node<Type> >()),
-              node);
-        }
-        else
-        {
-          ++jt;
-        }
-      }
-    }
-  }
-
-  // Extract sorted values
-  std::vector<T> res;
-  res.reserve(data.size());
-  for (typename std::vector<Node<Type> >::iterator it = tmp.begin(); it != tmp.end(); ++it)
-  {
-    T *value;
-    it->getValue(value);
-    res.push_back(*value);
-  }
-  data.swap(res);
-}
-
-template <typename T>
-void sort(std::list<T> &data)
+// Re-runs both containers under PhaseMetrics; the timed runs in PmergeMe()
+// stay uninstrumented apart from the comparison count.
+static void reportMetrics(int *data, std::size_t size, Options const &options)
 {
-  if (data.size() < 2)
-    return;
-  typedef typename TypeSelector<T>::type Type;
-  std::list<Node<Type> > large, small;
-
-  // Pairing phase
-  for (typename std::list<T>::iterator it = data.begin(); it != data.end(); ++it)
-  {
-    typename std::list<T>::iterator pre = it++;
-    if (it == data.end())
-    {
-      small.push_back(&*pre);
-      break;
-    }
-    bool isLess = *pre < *it;
-    large.push_back(isLess ? &*it : &*pre);
-    small.push_back(isLess ? &*pre : &*it);
-    large.back().push(&small.back());
-  }
-
-  // Recursive sort on 'large'
-  sort(large);
+  PhaseMetrics vecMetrics("vector"), listMetrics("list");
+  std::vector<int> v1(data, data + size);
+  sort(v1, vecMetrics);
+  std::list<int> v2(data, data + size);
+  sort(v2, listMetrics);
 
-  // Merge-insert phase
-  std::list<Node<Type> > tmp;
+  if (options.metrics)
   {
-    bool finished = false;
-    typename std::list<Node<Type> >::iterator it = large.begin();
-    tmp.push_back(*it->pop());
-    tmp.push_back(*it);
-    ++it;
-
-    for (std::size_t n = 1; !finished; ++n)
-    {
-      // Take the next 2*J(n) elements from 'large'
-      for (std::size_t j = 2 * jacobsthal(n); j > 0; --j)
-      {
-        if (it == large.end())
-        {
-          if (data.size() % 2)
-          {
-            Node<Type> &node = small.back();
-            tmp.insert(
-                std::lower_bound(tmp.begin(), tmp.end(), node, CompareNode<Node<Type> >()),
-                node);
-          }
-          finished = true;
-          break;
-        }
-        tmp.push_back(*it);
-        ++it;
-      }
-      // Now insert paired elements back into tmp
-      for (typename std::list<Node<Type> >::reverse_iterator jt = tmp.rbegin();
-           jt != tmp.rend(); ++jt)
-      {
-        if (jt->hasPair())
-        {
-          Node<Type> &node = *jt->pop();
-          tmp.insert(
-              std::lower_bound(tmp.begin(), --jt.base(), node, CompareNode<Node<Type> >()),
-              node);
-        }
-      }
-    }
+    vecMetrics.report(std::cout);
+    listMetrics.report(std::cout);
   }
-
-  // Extract sorted values
-  std::list<T> res;
-  for (typename std::list<Node<Type> >::iterator it = tmp.begin(); it != tmp.end(); ++it)
+  if (options.trace)
   {
-    T *value;
-    it->getValue(value);
-    res.push_back(*value);
+    std::ofstream file(options.trace);
+    if (!file.is_open())
+      throw std::runtime_error("trace");
+    std::vector<PhaseMetrics const *> runs;
+    runs.push_back(&vecMetrics);
+    runs.push_back(&listMetrics);
+    writeTrace(file, runs);
   }
-  data.swap(res);
 }
 
-void PmergeMe(int *data, std::size_t size)
+void PmergeMe(int *data, std::size_t size, Options const &options)
 {
   // Vector-based sort
-  comparisonCount = 0;
+  CountMetrics vecCount;
   unsigned long start = getTime();
   std::vector<int> v1(data, data + size);
-  sort(v1);
+  sort(v1, vecCount);
   unsigned long middle = getTime();
-  unsigned long cmpVec = comparisonCount;
 
   // List-based sort
-  comparisonCount = 0;
+  CountMetrics listCount;
   std::list<int> v2(data, data + size);
-  sort(v2);
+  sort(v2, listCount);
   unsigned long end = getTime();
-  unsigned long cmpList = comparisonCount;
+
+  // Radix sort, when selected, is timed after the two containers above
+  bool radix = options.engine == ENGINE_RADIX ||
+               (options.engine == ENGINE_AUTO && size >= RADIX_THRESHOLD);
+  unsigned long radixTime = 0;
+  std::vector<int> v3;
+  if (radix)
+  {
+    unsigned long begin = getTime();
+    v3.assign(data, data + size);
+    if (size)
+      radixSort(&v3[0], size);
+    radixTime = getTime() - begin;
+  }
 
   // Output
   std::cout << "Before:\t";
   printData(data, data + size);
-  std::cout << "After (vector):\t";
-  printData(v1.begin(), v1.end());
+  if (radix)
+  {
+    std::cout << "After (radix):\t";
+    printData(v3.begin(), v3.end());
+  }
+  else
+  {
+    std::cout << "After (vector):\t";
+    printData(v1.begin(), v1.end());
+  }
   // std::cout << "After (list):\t";
   // printData(v2.begin(), v2.end());
 
@@ -253,11 +118,20 @@ void PmergeMe(int *data, std::size_t size)
             << "Time to process a range of " << std::setw(3)
             << std::setfill(' ') << size
             << " elements with std::list   : " << (end - middle) << " us"
-            << std::endl
-            << "Comparisons (vector)        : " << cmpVec << std::endl
-            << "Comparisons (list)          : " << cmpList << std::endl;
+            << std::endl;
+  if (radix)
+    std::cout << "Time to process a range of " << std::setw(3)
+              << std::setfill(' ') << size
+              << " elements with radix sort  : " << radixTime << " us"
+              << std::endl;
+  std::cout << "Comparisons (vector)        : " << vecCount.comparisons << std::endl
+            << "Comparisons (list)          : " << listCount.comparisons << std::endl;
+
+  if (options.metrics || options.trace)
+    reportMetrics(data, size, options);
 }
 
+
 // #include "PmergeMe.hpp"
 
 // #include <iomanip>
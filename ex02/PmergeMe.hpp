@@ -10,7 +10,20 @@
 unsigned long getTime();
 unsigned long jacobsthal(unsigned long);
 
-void PmergeMe(int *data, std::size_t size);
+// --engine=merge|radix|auto: merge-insertion only, or also a radix sort
+// timed next to it (auto: radix from RADIX_THRESHOLD elements on)
+enum Engine { ENGINE_MERGE, ENGINE_RADIX, ENGINE_AUTO };
+
+// Command line switches of ./PmergeMe
+struct Options {
+  bool metrics;      // --metrics: print the per-phase report
+  char const *trace; // --trace=FILE: write a Chrome trace of the phases
+  Engine engine;
+
+  Options() : metrics(false), trace(NULL), engine(ENGINE_MERGE) {};
+};
+
+void PmergeMe(int *data, std::size_t size, Options const &options);
 
 template <typename T> class Node {
 private:
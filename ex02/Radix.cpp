@@ -0,0 +1,159 @@
+// Radix.cpp
+#include "Radix.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include <pthread.h>
+#include <unistd.h>
+
+#define RADIX_BITS 8
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+#define RADIX_PASSES 4
+// Smallest slice worth a thread of its own
+#define RADIX_CHUNK (1 << 16)
+
+// Flipping the sign bit makes unsigned order match signed order
+static inline unsigned keyOf(int value)
+{
+  return static_cast<unsigned>(value) ^ 0x80000000u;
+}
+
+static inline unsigned digitOf(int value, unsigned pass)
+{
+  return keyOf(value) >> (pass * RADIX_BITS) & (RADIX_BUCKETS - 1);
+}
+
+struct Chunk
+{
+  int const *src;
+  int *dst;
+  std::size_t begin;
+  std::size_t end;
+  unsigned pass;
+  // Histograms of every digit, then the scatter offsets of 'pass'
+  std::size_t count[RADIX_PASSES][RADIX_BUCKETS];
+};
+
+// One read per key feeds four independent tables; no increment waits on
+// the previous one, so the loop keeps several loads in flight.
+static void *countAll(void *arg)
+{
+  Chunk &chunk = *static_cast<Chunk *>(arg);
+  std::memset(chunk.count, 0, sizeof(chunk.count));
+  for (std::size_t i = chunk.begin; i < chunk.end; ++i)
+  {
+    unsigned key = keyOf(chunk.src[i]);
+    ++chunk.count[0][key & 0xff];
+    ++chunk.count[1][key >> 8 & 0xff];
+    ++chunk.count[2][key >> 16 & 0xff];
+    ++chunk.count[3][key >> 24];
+  }
+  return NULL;
+}
+
+static void *countPass(void *arg)
+{
+  Chunk &chunk = *static_cast<Chunk *>(arg);
+  std::size_t *count = chunk.count[chunk.pass];
+  std::memset(count, 0, sizeof(chunk.count[0]));
+  for (std::size_t i = chunk.begin; i < chunk.end; ++i)
+    ++count[digitOf(chunk.src[i], chunk.pass)];
+  return NULL;
+}
+
+static void *scatter(void *arg)
+{
+  Chunk &chunk = *static_cast<Chunk *>(arg);
+  std::size_t *offset = chunk.count[chunk.pass];
+  for (std::size_t i = chunk.begin; i < chunk.end; ++i)
+  {
+    int value = chunk.src[i];
+    chunk.dst[offset[digitOf(value, chunk.pass)]++] = value;
+  }
+  return NULL;
+}
+
+// Runs 'fn' on every chunk, the first one on the calling thread
+static void runChunks(void *(*fn)(void *), std::vector<Chunk> &chunks)
+{
+  std::vector<pthread_t> threads(chunks.size() - 1);
+  std::size_t started = 0;
+  for (; started < threads.size(); ++started)
+    if (pthread_create(&threads[started], NULL, fn, &chunks[started + 1]))
+      break;
+  for (std::size_t i = started + 1; i < chunks.size(); ++i)
+    fn(&chunks[i]);
+  fn(&chunks[0]);
+  for (std::size_t i = 0; i < started; ++i)
+    pthread_join(threads[i], NULL);
+}
+
+static unsigned threadCount(std::size_t size, unsigned threads)
+{
+  if (threads == 0)
+  {
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = online > 0 ? online : 1;
+  }
+  std::size_t most = size / RADIX_CHUNK;
+  if (most < threads)
+    threads = most ? most : 1;
+  return threads;
+}
+
+void radixSort(int *data, std::size_t size, unsigned threads)
+{
+  if (size < 2)
+    return;
+  std::vector<int> buffer(size);
+  std::vector<Chunk> chunks(threadCount(size, threads));
+  for (std::size_t c = 0; c < chunks.size(); ++c)
+  {
+    chunks[c].src = data;
+    chunks[c].begin = size * c / chunks.size();
+    chunks[c].end = size * (c + 1) / chunks.size();
+  }
+  runChunks(countAll, chunks);
+
+  int *src = data;
+  int *dst = &buffer[0];
+  bool counted = true;
+  for (unsigned pass = 0; pass < RADIX_PASSES; ++pass)
+  {
+    std::size_t total[RADIX_BUCKETS] = {0};
+    for (std::size_t c = 0; c < chunks.size(); ++c)
+      for (unsigned b = 0; b < RADIX_BUCKETS; ++b)
+        total[b] += chunks[c].count[pass][b];
+    // Every key has the same digit: this pass would copy the data as is
+    if (total[digitOf(src[0], pass)] == size)
+      continue;
+
+    for (std::size_t c = 0; c < chunks.size(); ++c)
+    {
+      chunks[c].src = src;
+      chunks[c].dst = dst;
+      chunks[c].pass = pass;
+    }
+    // Chunk histograms only hold for the order they were counted in
+    if (!counted && chunks.size() > 1)
+      runChunks(countPass, chunks);
+
+    // Bucket b of chunk c lands after all smaller buckets and after bucket
+    // b of the chunks before c
+    std::size_t offset = 0;
+    for (unsigned b = 0; b < RADIX_BUCKETS; ++b)
+      for (std::size_t c = 0; c < chunks.size(); ++c)
+      {
+        std::size_t n = chunks[c].count[pass][b];
+        chunks[c].count[pass][b] = offset;
+        offset += n;
+      }
+    runChunks(scatter, chunks);
+    std::swap(src, dst);
+    counted = false;
+  }
+  if (src != data)
+    std::copy(src, src + size, data);
+}
@@ -0,0 +1,18 @@
+
+#pragma once
+#ifndef __RADIX_HPP__
+#define __RADIX_HPP__
+
+#include <cstddef>
+
+// Below this many elements --engine=auto keeps merge-insertion
+#define RADIX_THRESHOLD 256
+
+// LSD radix sort of 32-bit ints, one byte per pass. The histograms of all
+// four digits come from a single read of the data, and passes whose digit is
+// the same for every key are skipped. With threads > 1 (0: one per online
+// CPU) large inputs are split into chunks that are counted and scattered
+// concurrently.
+void radixSort(int *data, std::size_t size, unsigned threads = 0);
+
+#endif
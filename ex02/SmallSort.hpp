@@ -0,0 +1,177 @@
+
+#pragma once
+#ifndef __SMALLSORT_HPP__
+#define __SMALLSORT_HPP__
+
+#include <cstddef>
+
+// Largest subproblem MergeInsertion hands to SmallSort
+#define SMALL_SORT_MAX 16
+
+// Merge-insertion for a size known at compile time. Every loop bound, the
+// Jacobsthal groups and the recursion are fixed by N, so each SmallSort<N>
+// compiles to straight-line code over arrays on the stack. It makes the very
+// same comparisons as MergeInsertion, binary searches included, so switching
+// to it never changes the comparison count; it only drops the per-level
+// containers and chains.
+
+template <unsigned n> struct Jacobsthal {
+  enum { value = Jacobsthal<n - 1>::value + 2 * Jacobsthal<n - 2>::value };
+};
+
+template <> struct Jacobsthal<1> {
+  enum { value = 1 };
+};
+
+template <> struct Jacobsthal<0> {
+  enum { value = 0 };
+};
+
+// Index of the last pair inserted by group n (group 0 is b0 alone)
+template <unsigned n> struct GroupEnd {
+  enum { value = GroupEnd<n - 1>::value + 2 * Jacobsthal<n>::value };
+};
+
+template <> struct GroupEnd<0> {
+  enum { value = 0 };
+};
+
+// The chain being built, with the position of each sorted larger element
+template <typename E, std::size_t N> struct SmallChain {
+  E *item[N];
+  std::size_t pos[N / 2 + 1];
+  std::size_t len;
+
+  // Same halving as std::lower_bound
+  template <typename Metrics>
+  std::size_t lowerBound(std::size_t count, E *key, Metrics &metrics) const {
+    std::size_t first = 0;
+    while (count > 0) {
+      std::size_t half = count >> 1;
+      metrics.compare();
+      if (*item[first + half] < *key) {
+        first += half + 1;
+        count -= half + 1;
+      } else
+        count = half;
+    }
+    return first;
+  };
+  template <typename Metrics>
+  void insert(std::size_t count, E *key, Metrics &metrics) {
+    std::size_t at = lowerBound(count, key, metrics);
+    for (std::size_t i = len; i > at; --i)
+      item[i] = item[i - 1];
+    item[at] = key;
+    ++len;
+    for (std::size_t k = 0; k < N / 2; ++k)
+      if (pos[k] >= at)
+        ++pos[k];
+  };
+};
+
+// Inserts group n and the ones after it
+template <std::size_t N, unsigned n,
+          bool More = (GroupEnd<n - 1>::value + 1 < N / 2)>
+struct InsertGroups {
+  static std::size_t const done = GroupEnd<n - 1>::value;
+  static std::size_t const end = GroupEnd<n>::value;
+  static std::size_t const top = end < N / 2 ? end : N / 2 - 1;
+  static bool const partial = end >= N / 2;
+
+  template <typename E, typename Metrics>
+  static void run(SmallChain<E, N> &chain, E *const *small, Metrics &metrics) {
+    // The pairs run out inside this group: the odd element goes first
+    if (partial && N % 2)
+      chain.insert(chain.len, small[N / 2], metrics);
+    for (std::size_t k = top; k > done; --k)
+      chain.insert(chain.pos[k], small[k], metrics);
+    InsertGroups<N, n + 1>::run(chain, small, metrics);
+  };
+};
+
+template <std::size_t N, unsigned n> struct InsertGroups<N, n, false> {
+  template <typename E, typename Metrics>
+  static void run(SmallChain<E, N> &chain, E *const *small, Metrics &metrics) {
+    // The pairs ran out exactly at a group boundary
+    if (N % 2 && GroupEnd<n - 1>::value < N / 2)
+      chain.insert(chain.len, small[N / 2], metrics);
+  };
+};
+
+template <std::size_t N> struct SmallSort {
+  // Writes keys[0, N) in ascending order of their elements to 'out'
+  template <typename E, typename Metrics>
+  static void run(E *const *keys, E **out, Metrics &metrics) {
+    // Pairing phase, same order and tie-break as MergeInsertion
+    E *large[N / 2 + 1], *small[N / 2 + 1];
+    for (std::size_t i = 0; i < N / 2; ++i) {
+      metrics.compare();
+      bool isLess = *keys[2 * i] < *keys[2 * i + 1];
+      large[i] = isLess ? keys[2 * i + 1] : keys[2 * i];
+      small[i] = isLess ? keys[2 * i] : keys[2 * i + 1];
+    }
+    if (N % 2)
+      small[N / 2] = keys[N - 1];
+
+    // Recursive sort on 'large', then line the partners up behind it
+    E *sorted[N / 2 + 1] = {0}, *partner[N / 2 + 1] = {0};
+    SmallSort<N / 2>::run(large, sorted, metrics);
+    for (std::size_t k = 0; k < N / 2; ++k)
+      for (std::size_t i = 0; i < N / 2; ++i)
+        if (sorted[k] == large[i])
+          partner[k] = small[i];
+    if (N % 2)
+      partner[N / 2] = small[N / 2];
+
+    // Merge-insert phase: b0 then a0 .. a(N/2 - 1)
+    SmallChain<E, N> chain;
+    chain.item[0] = partner[0];
+    for (std::size_t k = 0; k < N / 2; ++k) {
+      chain.item[k + 1] = sorted[k];
+      chain.pos[k] = k + 1;
+    }
+    chain.len = N / 2 + 1;
+    InsertGroups<N, 1>::run(chain, partner, metrics);
+    for (std::size_t i = 0; i < N; ++i)
+      out[i] = chain.item[i];
+  };
+};
+
+template <> struct SmallSort<1> {
+  template <typename E, typename Metrics>
+  static void run(E *const *keys, E **out, Metrics &) {
+    out[0] = keys[0];
+  };
+};
+
+template <> struct SmallSort<0> {
+  template <typename E, typename Metrics>
+  static void run(E *const *, E **, Metrics &) {};
+};
+
+// Runtime size to the matching SmallSort, for sizes up to SMALL_SORT_MAX
+template <typename E, typename Metrics>
+void smallSort(E *const *keys, E **out, std::size_t size, Metrics &metrics) {
+  switch (size) {
+  case 0: SmallSort<0>::run(keys, out, metrics); break;
+  case 1: SmallSort<1>::run(keys, out, metrics); break;
+  case 2: SmallSort<2>::run(keys, out, metrics); break;
+  case 3: SmallSort<3>::run(keys, out, metrics); break;
+  case 4: SmallSort<4>::run(keys, out, metrics); break;
+  case 5: SmallSort<5>::run(keys, out, metrics); break;
+  case 6: SmallSort<6>::run(keys, out, metrics); break;
+  case 7: SmallSort<7>::run(keys, out, metrics); break;
+  case 8: SmallSort<8>::run(keys, out, metrics); break;
+  case 9: SmallSort<9>::run(keys, out, metrics); break;
+  case 10: SmallSort<10>::run(keys, out, metrics); break;
+  case 11: SmallSort<11>::run(keys, out, metrics); break;
+  case 12: SmallSort<12>::run(keys, out, metrics); break;
+  case 13: SmallSort<13>::run(keys, out, metrics); break;
+  case 14: SmallSort<14>::run(keys, out, metrics); break;
+  case 15: SmallSort<15>::run(keys, out, metrics); break;
+  case 16: SmallSort<16>::run(keys, out, metrics); break;
+  }
+}
+
+#endif
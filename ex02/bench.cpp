@@ -0,0 +1,190 @@
+// bench.cpp
+#include "InPlaceMergeInsertion.hpp"
+#include "MergeInsertion.hpp"
+#include "PmergeMe.hpp"
+#include "Radix.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <list>
+#include <stdexcept>
+#include <vector>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Times every path of the merge-insertion engines, and the radix sort next
+// to them, on the same random input and checks each result against
+// std::sort. Each path runs in its own child process so its peak RSS can be
+// told apart from the others'.
+// Output: one tab separated line per path and size; peak_kb is the growth of
+// the child's peak resident set while the container is built and sorted.
+
+struct Run
+{
+  unsigned long us;
+  unsigned long comparisons;
+  bool sorted;
+};
+
+typedef Run (*Path)(std::vector<int> const &input,
+                    std::vector<int> const &expected);
+
+template <typename Container>
+static Run finish(Container const &res, std::vector<int> const &expected,
+                  unsigned long start, CountMetrics const &metrics)
+{
+  Run run;
+  run.us = getTime() - start;
+  run.comparisons = metrics.comparisons;
+  run.sorted = res.size() == expected.size() &&
+               std::equal(res.begin(), res.end(), expected.begin());
+  return run;
+}
+
+static Run runArray(std::vector<int> const &input,
+                    std::vector<int> const &expected)
+{
+  CountMetrics metrics;
+  unsigned long start = getTime();
+  int *data = new int[input.size()];
+  std::copy(input.begin(), input.end(), data);
+  sortArray(data, data + input.size(), metrics);
+  Run run;
+  run.us = getTime() - start;
+  run.comparisons = metrics.comparisons;
+  run.sorted = std::equal(expected.begin(), expected.end(), data);
+  delete[] data;
+  return run;
+}
+
+static Run runVector(std::vector<int> const &input,
+                     std::vector<int> const &expected)
+{
+  CountMetrics metrics;
+  unsigned long start = getTime();
+  std::vector<int> data(input.begin(), input.end());
+  sort(data, metrics);
+  return finish(data, expected, start, metrics);
+}
+
+static Run runDeque(std::vector<int> const &input,
+                    std::vector<int> const &expected)
+{
+  CountMetrics metrics;
+  unsigned long start = getTime();
+  std::deque<int> data(input.begin(), input.end());
+  sort(data, metrics);
+  return finish(data, expected, start, metrics);
+}
+
+static Run runList(std::vector<int> const &input,
+                   std::vector<int> const &expected)
+{
+  CountMetrics metrics;
+  unsigned long start = getTime();
+  std::list<int> data(input.begin(), input.end());
+  sort(data, metrics);
+  return finish(data, expected, start, metrics);
+}
+
+static Run runInPlace(std::vector<int> const &input,
+                      std::vector<int> const &expected)
+{
+  CountMetrics metrics;
+  unsigned long start = getTime();
+  std::vector<int> data(input.begin(), input.end());
+  sortInPlace(data.begin(), data.end(), metrics);
+  return finish(data, expected, start, metrics);
+}
+
+static Run runRadix(std::vector<int> const &input,
+                    std::vector<int> const &expected)
+{
+  CountMetrics metrics;
+  unsigned long start = getTime();
+  std::vector<int> data(input.begin(), input.end());
+  radixSort(&data[0], data.size());
+  return finish(data, expected, start, metrics);
+}
+
+static struct
+{
+  char const *name;
+  Path run;
+} const paths[] = {
+    {"array", runArray},   {"vector", runVector},   {"deque", runDeque},
+    {"list", runList},     {"inplace", runInPlace}, {"radix", runRadix},
+};
+
+static long peakKb()
+{
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+static std::size_t parseSize(char const *str)
+{
+  char *endptr;
+  errno = 0;
+  unsigned long n = std::strtoul(str, &endptr, 10);
+  if (errno || endptr == str || *endptr || n == 0)
+    throw std::runtime_error("Invalid size");
+  return n;
+}
+
+static void bench(std::size_t size)
+{
+  std::vector<int> input(size);
+  for (std::size_t i = 0; i < size; ++i)
+    input[i] = std::rand();
+  std::vector<int> expected(input);
+  std::sort(expected.begin(), expected.end());
+
+  for (std::size_t i = 0; i < sizeof(paths) / sizeof(paths[0]); ++i)
+  {
+    std::cout.flush();
+    pid_t pid = fork();
+    if (pid < 0)
+      throw std::runtime_error("fork");
+    if (pid == 0)
+    {
+      long before = peakKb();
+      Run run = paths[i].run(input, expected);
+      std::cout << paths[i].name << '\t' << size << '\t' << run.us << '\t'
+                << run.comparisons << '\t' << peakKb() - before << std::endl;
+      std::exit(run.sorted ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+    int status;
+    if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) ||
+        WEXITSTATUS(status) != EXIT_SUCCESS)
+      throw std::runtime_error(paths[i].name);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  try
+  {
+    std::srand(42);
+    std::cout << "# path\tsize\tus\tcomparisons\tpeak_kb" << std::endl;
+    if (argc < 2)
+    {
+      static std::size_t const sizes[] = {1000, 3000, 10000, 30000};
+      for (std::size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i)
+        bench(sizes[i]);
+    }
+    for (int i = 1; i < argc; ++i)
+      bench(parseSize(argv[i]));
+    return EXIT_SUCCESS;
+  }
+  catch (const std::exception &e)
+  {
+    std::cerr << "Error: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+}
@@ -14,6 +14,7 @@
 
 #include <cerrno>
 #include <cstdlib>
+#include <cstring>
 #include <limits>
 #include <stdexcept>
 
@@ -28,14 +29,36 @@ int ft_stoi(char *str) {
   return i;
 }
 
+// Consumes the leading "--" switches and returns the index of the first number
+int parseOptions(int argc, char **argv, Options &options) {
+  int i = 1;
+  for (; i < argc && std::strncmp(argv[i], "--", 2) == 0; i++) {
+    if (std::strcmp(argv[i], "--metrics") == 0)
+      options.metrics = true;
+    else if (std::strncmp(argv[i], "--trace=", 8) == 0 && argv[i][8])
+      options.trace = argv[i] + 8;
+    else if (std::strcmp(argv[i], "--engine=merge") == 0)
+      options.engine = ENGINE_MERGE;
+    else if (std::strcmp(argv[i], "--engine=radix") == 0)
+      options.engine = ENGINE_RADIX;
+    else if (std::strcmp(argv[i], "--engine=auto") == 0)
+      options.engine = ENGINE_AUTO;
+    else
+      throw std::runtime_error("Invalid option");
+  }
+  return i;
+}
+
 int main(int argc, char **argv) {
   try {
-    std::size_t size = argc - 1;
+    Options options;
+    int first = parseOptions(argc, argv, options);
+    std::size_t size = argc - first;
     int data[size];
     for (std::size_t i = 0; i < size; i++)
-      if ((data[i] = ft_stoi(argv[i + 1])) < 0)
+      if ((data[i] = ft_stoi(argv[first + i])) < 0)
         throw std::runtime_error("Invalid argument");
-    PmergeMe(data, size);
+    PmergeMe(data, size, options);
     return EXIT_SUCCESS;
   } catch (const std::exception &e) {
     std::cerr << "Error" << std::endl;